@@ -0,0 +1,42 @@
+#include "alloc_tracker.hpp"
+
+#if defined(RPS_TRACK_ALLOCATIONS)
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> g_allocation_count = 0;
+
+void* operator new(std::size_t size)
+{
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+namespace util {
+
+uint64_t allocation_count()
+{
+#if defined(RPS_TRACK_ALLOCATIONS)
+    return g_allocation_count.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+}
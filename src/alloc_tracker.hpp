@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief Get number of heap allocations made through operator new since startup
+ * @return - Returns allocation count, always 0 unless built with RPS_TRACK_ALLOCATIONS
+ */
+uint64_t allocation_count();
+
+}
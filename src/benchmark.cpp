@@ -0,0 +1,889 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_tracker.hpp"
+#include "perf_counters.hpp"
+#include "profiler.hpp"
+#include "simulation.hpp"
+
+namespace rps {
+
+/**
+ * @brief Hardware counters of the movement, grid and collision kernels of a tick
+ */
+using KernelCounters = std::array<util::PerfCounters, 3>;
+
+// Ticks run before timing or counting so targets and the grid are warm
+static const int c_warmup_ticks = 2;
+
+/**
+ * @brief Headless workload of the perf check, run from fixed seeds
+ */
+struct PerfScenario {
+    const char* name;
+    int piece_count;
+    // Pieces per area relative to the configuration
+    float density;
+    float dominant_share;
+    int ticks;
+    // Toroidal scenarios also collide pieces across the world edges
+    WorldTopology topology;
+};
+
+/**
+ * @brief Create a late-game population dominated by one piece type
+ * @param config - Configuration the density is taken from
+ * @param piece_count - Number of pieces
+ * @param density - Pieces per area relative to the configuration
+ * @param dominant_share - Fraction of pieces of the dominant type, the rest is split between the other two types
+ * @param sim - Simulation to reset
+ * @throws std::runtime_error if the population does not fit in the memory budget
+ */
+static void reset_population(
+    const RockPaperScissorsConfig& config, int piece_count, float density, float dominant_share, Simulation& sim)
+{
+    // World grows with the piece count so density, and with it collision cost, stays fixed
+    const float scale
+        = std::sqrt(static_cast<float>(piece_count) / (static_cast<float>(config.piece_count) * density));
+    sim.world = World {
+        .width = static_cast<int>(static_cast<float>(config.world_width) * scale),
+        .height = static_cast<int>(static_cast<float>(config.world_height) * scale),
+        .topology = config.world_topology,
+    };
+    sim.spawner.random.seed(1);
+    sim.spawner.placement = config.spawn_placement;
+    sim.random.seed(2);
+    sim.tick = 0;
+    check_memory_budget(
+        piece_count, estimate_memory_bytes(piece_count, 0), static_cast<size_t>(config.memory_budget_mb) * 1024 * 1024);
+    reset_pieces(sim, piece_count);
+
+    // Late game: rocks dominate, positions are random so the minorities are spread over the world
+    const int dominant_count = static_cast<int>(static_cast<float>(piece_count) * dominant_share);
+    for (int i = 0; i < piece_count; i++) {
+        set_piece_type(
+            sim, i, i < dominant_count ? PieceType::e_rock : static_cast<PieceType>(1 + (i - dominant_count) % 2));
+    }
+}
+
+/**
+ * @brief Get movement parameters of the benchmark
+ * @param config - Configuration the movement is taken from
+ * @return - Returns movement parameters
+ */
+static Movement benchmark_movement(const RockPaperScissorsConfig& config)
+{
+    // Targets are searched every tick so the sampling cost is not hidden by the target cache
+    return Movement {
+        .model = config.movement_model,
+        .piece_size = config.piece_size,
+        .samples = config.piece_samples,
+        .max_acceleration = config.max_acceleration,
+        .damping = config.velocity_damping,
+        .target_refresh_ticks = 1,
+        .target_distance_band = config.target_distance_band,
+    };
+}
+
+/**
+ * @brief Time simulation ticks of one population
+ * @tparam Scalar - Type tick math is computed in
+ * @param config - Configuration the density and movement are taken from
+ * @param piece_count - Number of pieces
+ * @param density - Pieces per area relative to the configuration
+ * @param dominant_share - Fraction of pieces of the dominant type
+ * @param ticks - Number of timed ticks
+ * @return - Returns average time per tick in milliseconds
+ */
+template <typename Scalar = SimulationScalar>
+static double time_ticks(
+    const RockPaperScissorsConfig& config, int piece_count, float density, float dominant_share, int ticks)
+{
+    Simulation sim {};
+    reset_population(config, piece_count, density, dominant_share, sim);
+    const Movement movement = benchmark_movement(config);
+
+    for (int i = 0; i < c_warmup_ticks; i++) {
+        step<Scalar>(sim, movement);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ticks; i++) {
+        step<Scalar>(sim, movement);
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ticks;
+}
+
+/**
+ * @brief Count hardware events of each tick kernel over the same ticks as time_ticks
+ * @param config - Configuration the density and movement are taken from
+ * @param piece_count - Number of pieces
+ * @param dominant_share - Fraction of pieces of the dominant type
+ * @param ticks - Number of counted ticks
+ * @param counters - Counters of the movement, grid and collision kernels, reset before counting
+ */
+static void count_kernel_events(
+    const RockPaperScissorsConfig& config,
+    int piece_count,
+    float dominant_share,
+    int ticks,
+    KernelCounters& counters)
+{
+    Simulation sim {};
+    reset_population(config, piece_count, 1.0f, dominant_share, sim);
+    const Movement movement = benchmark_movement(config);
+
+    for (int i = 0; i < c_warmup_ticks; i++) {
+        step(sim, movement);
+    }
+    for (util::PerfCounters& kernel_counters : counters) {
+        kernel_counters.reset();
+    }
+    // Same kernels in the same order as step
+    for (int i = 0; i < ticks; i++) {
+        counters[0].start();
+        move_pieces(sim, movement);
+        counters[0].stop();
+        counters[1].start();
+        update_grid(sim, movement.piece_size);
+        counters[1].stop();
+        counters[2].start();
+        update_collisions(sim, movement.piece_size);
+        counters[2].stop();
+        sim.tick++;
+    }
+}
+
+/**
+ * @brief Print hardware events per piece and tick of each kernel, "-" for events that are not available
+ * @param piece_count - Number of pieces
+ * @param dominant_share - Fraction of pieces of the dominant type
+ * @param ticks - Number of counted ticks
+ * @param counters - Counters of the movement, grid and collision kernels
+ */
+static void print_kernel_events(int piece_count, float dominant_share, int ticks, const KernelCounters& counters)
+{
+    const char* kernel_names[] = { "movement", "grid", "collisions" };
+    const double samples = static_cast<double>(piece_count) * static_cast<double>(ticks);
+    for (int kernel = 0; kernel < counters.size(); kernel++) {
+        std::printf("%10d %9.1f%% %-11s", piece_count, dominant_share * 100.0f, kernel_names[kernel]);
+        for (int event = 0; event < util::c_perf_event_count; event++) {
+            const std::optional<double> count = counters[kernel].read(static_cast<util::PerfEvent>(event));
+            if (count.has_value()) {
+                std::printf(" %14.3f", count.value() / samples);
+            }
+            else {
+                std::printf(" %14s", "-");
+            }
+        }
+        const std::optional<double> cycles = counters[kernel].read(util::PerfEvent::e_cycles);
+        const std::optional<double> instructions = counters[kernel].read(util::PerfEvent::e_instructions);
+        if (cycles.has_value() && instructions.has_value() && cycles.value() > 0.0) {
+            std::printf(" %6.2f\n", instructions.value() / cycles.value());
+        }
+        else {
+            std::printf(" %6s\n", "-");
+        }
+    }
+}
+
+void run_benchmark(const RockPaperScissorsConfig& config)
+{
+    const int piece_counts[] = { 10000, 100000 };
+    const float dominant_shares[] = { 0.34f, 0.9f, 0.99f, 0.999f };
+    const int ticks = 20;
+
+#if defined(RPS_PROFILE)
+    if (config.trace_at_start) {
+        // Warmup and timed ticks of the whole sweep fit, so the trace covers every population
+        util::profile_trace_start(1 << 20);
+    }
+#else
+    if (config.trace_at_start) {
+        std::fprintf(stderr, "Tracing requires profile zones, configure with RPS_PROFILE\n");
+    }
+#endif
+
+    std::printf("%10s %10s %12s\n", "pieces", "dominant", "ms/tick");
+    for (int piece_count : piece_counts) {
+        for (float dominant_share : dominant_shares) {
+            const double ms = time_ticks(config, piece_count, 1.0f, dominant_share, ticks);
+            std::printf("%10d %9.1f%% %12.3f\n", piece_count, dominant_share * 100.0f, ms);
+        }
+    }
+
+    // Fixed-point ticks give the same result on every platform, their cost against float decides whether to use them
+    std::printf("\n%10s %12s %12s %8s\n", "pieces", "float ms", "fixed ms", "ratio");
+    for (int piece_count : piece_counts) {
+        const double float_ms = time_ticks<float>(config, piece_count, 1.0f, 0.34f, ticks);
+        const double fixed_ms = time_ticks<util::Fixed>(config, piece_count, 1.0f, 0.34f, ticks);
+        std::printf("%10d %12.3f %12.3f %8.2f\n", piece_count, float_ms, fixed_ms, fixed_ms / float_ms);
+    }
+
+    // Event counts per piece and tick show whether a change to a kernel or the piece layout reduced misses
+    KernelCounters counters;
+    if (counters[0].is_available()) {
+        std::printf("\n%10s %10s %-11s", "pieces", "dominant", "kernel");
+        for (int event = 0; event < util::c_perf_event_count; event++) {
+            std::printf(" %14s", util::perf_event_name(static_cast<util::PerfEvent>(event)));
+        }
+        std::printf(" %6s\n", "IPC");
+        for (int piece_count : piece_counts) {
+            for (float dominant_share : dominant_shares) {
+                count_kernel_events(config, piece_count, dominant_share, ticks, counters);
+                print_kernel_events(piece_count, dominant_share, ticks, counters);
+            }
+        }
+    }
+    if (!counters[0].error().empty()) {
+        std::printf("\n%s\n", counters[0].error().c_str());
+    }
+
+#if defined(RPS_PROFILE)
+    if (util::profile_trace_active()) {
+        const size_t event_count = util::profile_trace_stop(config.trace_path);
+        std::printf("Wrote %zu trace events to %s\n", event_count, config.trace_path.c_str());
+    }
+#endif
+}
+
+/**
+ * @brief Get scenarios of the perf check
+ * @return - Returns scenarios
+ */
+static std::span<const PerfScenario> perf_scenarios()
+{
+    static const PerfScenario scenarios[] = {
+        { .name = "sparse",
+          .piece_count = 5000,
+          .density = 0.25f,
+          .dominant_share = 0.34f,
+          .ticks = 200,
+          .topology = WorldTopology::e_bounded },
+        { .name = "dense",
+          .piece_count = 5000,
+          .density = 4.0f,
+          .dominant_share = 0.34f,
+          .ticks = 200,
+          .topology = WorldTopology::e_bounded },
+        { .name = "dominated",
+          .piece_count = 20000,
+          .density = 1.0f,
+          .dominant_share = 0.99f,
+          .ticks = 50,
+          .topology = WorldTopology::e_bounded },
+        { .name = "large_world",
+          .piece_count = 100000,
+          .density = 1.0f,
+          .dominant_share = 0.34f,
+          .ticks = 10,
+          .topology = WorldTopology::e_bounded },
+        { .name = "toroidal",
+          .piece_count = 5000,
+          .density = 4.0f,
+          .dominant_share = 0.34f,
+          .ticks = 200,
+          .topology = WorldTopology::e_toroidal },
+    };
+    return scenarios;
+}
+
+/**
+ * @brief Measure ticks per second of a perf check scenario, the fastest of several runs to reduce noise
+ * @param config - Configuration the density and movement are taken from
+ * @param scenario - Scenario to run
+ * @return - Returns ticks per second
+ */
+static double measure_ticks_per_second(const RockPaperScissorsConfig& config, const PerfScenario& scenario)
+{
+    RockPaperScissorsConfig scenario_config = config;
+    scenario_config.world_topology = scenario.topology;
+    const int runs = 5;
+    double best_ms = std::numeric_limits<double>::max();
+    for (int i = 0; i < runs; i++) {
+        best_ms = std::min(
+            best_ms,
+            time_ticks(
+                scenario_config,
+                scenario.piece_count,
+                scenario.density,
+                scenario.dominant_share,
+                scenario.ticks));
+    }
+    return 1000.0 / best_ms;
+}
+
+/**
+ * @brief Read ticks per second of each scenario from a baseline file
+ * @param path - Path of baseline file
+ * @return - Returns ticks per second by scenario name, empty if the file does not exist
+ * @throws std::runtime_error if the file cannot be read or a line is malformed
+ */
+static std::map<std::string, double> read_perf_baseline(const std::string& path)
+{
+    if (!std::filesystem::exists(path)) {
+        return {};
+    }
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Unable to read perf baseline: " + path);
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(file, line)) {
+        // Comments and the header are skipped
+        if (line.empty() || line[0] == '#' || line.starts_with("scenario,")) {
+            continue;
+        }
+        const size_t comma = line.find(',');
+        try {
+            if (comma == std::string::npos) {
+                throw std::invalid_argument(line);
+            }
+            baseline[line.substr(0, comma)] = std::stod(line.substr(comma + 1));
+        }
+        catch (std::logic_error&) {
+            throw std::runtime_error("Malformed perf baseline line in " + path + ": " + line);
+        }
+    }
+    return baseline;
+}
+
+bool run_perf_check(const RockPaperScissorsConfig& config)
+{
+    const std::map<std::string, double> baseline = read_perf_baseline(config.perf_baseline_path);
+    if (baseline.empty()) {
+        // A machine without its own baseline still runs every scenario, only nothing can regress
+        std::fprintf(
+            stderr,
+            "No perf baseline in %s, write one with --perf-baseline\n",
+            config.perf_baseline_path.c_str());
+    }
+
+    int regressions = 0;
+    std::printf("scenario,baseline_ticks_per_sec,ticks_per_sec,change_percent,status\n");
+    for (const PerfScenario& scenario : perf_scenarios()) {
+        const double ticks_per_second = measure_ticks_per_second(config, scenario);
+        const auto it = baseline.find(scenario.name);
+        if (it == baseline.end()) {
+            std::printf("%s,,%.3f,,new\n", scenario.name, ticks_per_second);
+            continue;
+        }
+        const double change = ticks_per_second / it->second - 1.0;
+        const char* status = "ok";
+        if (change < -config.perf_tolerance) {
+            status = "slower";
+            regressions++;
+        }
+        else if (change > config.perf_tolerance) {
+            // Not a failure, but the baseline should be updated so later regressions are caught
+            status = "faster";
+        }
+        std::printf("%s,%.3f,%.3f,%.1f,%s\n", scenario.name, it->second, ticks_per_second, change * 100.0, status);
+    }
+    std::fflush(stdout);
+
+    if (regressions > 0) {
+        std::fprintf(
+            stderr,
+            "%d scenarios are more than %.0f%% slower than the baseline\n",
+            regressions,
+            config.perf_tolerance * 100.0f);
+    }
+    return regressions == 0;
+}
+
+void write_perf_baseline(const RockPaperScissorsConfig& config)
+{
+    std::ostringstream contents;
+    contents << "# Ticks per second of the perf check scenarios, regenerate with --perf-baseline on the reference "
+                "machine\n";
+    contents << "scenario,ticks_per_sec\n";
+    for (const PerfScenario& scenario : perf_scenarios()) {
+        const double ticks_per_second = measure_ticks_per_second(config, scenario);
+        contents << scenario.name << ',' << std::fixed << std::setprecision(3) << ticks_per_second << '\n';
+        std::printf("%s,%.3f\n", scenario.name, ticks_per_second);
+    }
+
+    std::ofstream file(config.perf_baseline_path);
+    file << contents.str();
+    if (!file) {
+        throw std::runtime_error("Unable to write perf baseline: " + config.perf_baseline_path);
+    }
+}
+
+/**
+ * @brief Timings of one configuration of the scaling sweep
+ */
+struct ScalingResult {
+    double ms_per_tick;
+    double movement_ms_per_tick;
+    double collisions_ms_per_tick;
+};
+
+/**
+ * @brief Time ticks of an even population with movement and collisions split over a thread pool
+ * @param config - Configuration the density and movement are taken from
+ * @param thread_pool - Threads pieces are moved and collided on
+ * @param piece_count - Number of pieces
+ * @param ticks - Number of timed ticks
+ * @param counters - Counters started and stopped around the timed ticks
+ * @return - Returns average time per tick of the whole tick, of movement and of collisions
+ */
+static ScalingResult time_scaling_ticks(
+    const RockPaperScissorsConfig& config,
+    util::ThreadPool& thread_pool,
+    int piece_count,
+    int ticks,
+    util::PerfCounters& counters)
+{
+    Simulation sim {};
+    reset_population(config, piece_count, 1.0f, 0.34f, sim);
+    sim.thread_pool = &thread_pool;
+    const Movement movement = benchmark_movement(config);
+
+    for (int i = 0; i < c_warmup_ticks; i++) {
+        step(sim, movement);
+    }
+    std::chrono::duration<double, std::milli> movement_time {};
+    std::chrono::duration<double, std::milli> collisions_time {};
+    counters.start();
+    const auto start = std::chrono::steady_clock::now();
+    // Same kernels in the same order as step
+    for (int i = 0; i < ticks; i++) {
+        const auto movement_start = std::chrono::steady_clock::now();
+        move_pieces(sim, movement);
+        movement_time += std::chrono::steady_clock::now() - movement_start;
+        update_grid(sim, movement.piece_size);
+        const auto collisions_start = std::chrono::steady_clock::now();
+        update_collisions(sim, movement.piece_size);
+        collisions_time += std::chrono::steady_clock::now() - collisions_start;
+        sim.tick++;
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    counters.stop();
+    return ScalingResult {
+        .ms_per_tick = elapsed.count() / ticks,
+        .movement_ms_per_tick = movement_time.count() / ticks,
+        .collisions_ms_per_tick = collisions_time.count() / ticks,
+    };
+}
+
+void run_scaling_benchmark(const RockPaperScissorsConfig& config)
+{
+    const int piece_counts[] = { 1000, 10000, 100000, 1000000, 10000000 };
+    // Powers of two up to the hardware thread count, and the hardware thread count itself
+    std::vector<int> thread_counts;
+    const int max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    // Estimated memory traffic per piece and tick, cache lines of neighbouring pieces are assumed to be shared:
+    // - movement reads and writes the piece, reads its previous position and writes the new one, and every target
+    //   sample reads a cache line of a random type index and one of its position
+    // - the grid reads the position, writes and reads the point cell, updates a cell start in the count and the
+    //   scatter pass and writes the index
+    // - collisions read the index, position and piece and write the conversion mark
+    const double cache_line_size = 64.0;
+    const double vector_size = static_cast<double>(sizeof(raylib::Vector2));
+    const double piece_size = static_cast<double>(sizeof(Piece));
+    const double movement_bytes = 2.0 * piece_size + 2.0 * vector_size
+        + 2.0 * static_cast<double>(config.piece_samples) * cache_line_size;
+    const double grid_bytes = vector_size + 7.0 * sizeof(int);
+    const double collisions_bytes = sizeof(int) + vector_size + piece_size + sizeof(uint8_t);
+    const double bytes_per_piece = movement_bytes + grid_bytes + collisions_bytes;
+
+    std::printf(
+        "threads,pieces,ticks,ms_per_tick,movement_ms_per_tick,collisions_ms_per_tick,speedup,efficiency,"
+        "est_bandwidth_gb_per_s,llc_bandwidth_gb_per_s\n");
+    for (int piece_count : piece_counts) {
+        // Fewer ticks for larger populations keep every configuration at a similar amount of work
+        const int ticks = std::clamp(1000000 / piece_count, 2, 200);
+        double single_thread_ms = 0.0;
+        for (int threads : thread_counts) {
+            // Opened before the pool so its threads are counted, their counts are added when they exit
+            util::PerfCounters counters;
+            ScalingResult result {};
+            {
+                util::ThreadPool thread_pool(threads);
+                result = time_scaling_ticks(config, thread_pool, piece_count, ticks, counters);
+            }
+            if (threads == 1) {
+                single_thread_ms = result.ms_per_tick;
+            }
+            const double speedup = single_thread_ms / result.ms_per_tick;
+            const double bandwidth = bytes_per_piece * piece_count / (result.ms_per_tick * 1e6);
+            std::printf(
+                "%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
+                threads,
+                piece_count,
+                ticks,
+                result.ms_per_tick,
+                result.movement_ms_per_tick,
+                result.collisions_ms_per_tick,
+                speedup,
+                speedup / threads,
+                bandwidth);
+            // Every LLC read miss fills a line from memory, write-backs are not counted
+            const std::optional<double> llc_misses = counters.read(util::PerfEvent::e_llc_misses);
+            if (llc_misses.has_value()) {
+                const double llc_bytes_per_tick = llc_misses.value() * cache_line_size / ticks;
+                std::printf("%.3f\n", llc_bytes_per_tick / (result.ms_per_tick * 1e6));
+            }
+            else {
+                std::printf("-\n");
+            }
+            std::fflush(stdout);
+        }
+    }
+}
+
+/**
+ * @brief Run ticks of a fixed-seed population and record the state checksum after every tick
+ * @param config - Configuration the density and movement are taken from
+ * @param thread_count - Number of threads pieces are moved on, ignored with domain workers
+ * @param worker_processes - Number of domain worker processes, 0 to move pieces on threads
+ * @param is_fixed_point - Step with util::Fixed tick math instead of the configured scalar type
+ * @param ticks - Number of ticks
+ * @return - Returns checksum after each tick
+ */
+static std::vector<uint64_t> tick_checksums(
+    const RockPaperScissorsConfig& config, int thread_count, int worker_processes, bool is_fixed_point, int ticks)
+{
+    const int piece_count = 20000;
+    Simulation sim {};
+    reset_population(config, piece_count, 1.0f, 0.34f, sim);
+    util::ThreadPool thread_pool(thread_count);
+    sim.thread_pool = &thread_pool;
+    if (worker_processes > 0) {
+        start_domain_workers(sim, worker_processes, piece_count);
+    }
+    // Targets are cached as in game so cache invalidation is checked too
+    const Movement movement {
+        .model = config.movement_model,
+        .piece_size = config.piece_size,
+        .samples = config.piece_samples,
+        .max_acceleration = config.max_acceleration,
+        .damping = config.velocity_damping,
+        .target_refresh_ticks = config.target_refresh_ticks,
+        .target_distance_band = config.target_distance_band,
+    };
+
+    std::vector<uint64_t> checksums;
+    for (int i = 0; i < ticks; i++) {
+        if (is_fixed_point) {
+            step<util::Fixed>(sim, movement);
+        }
+        else {
+            step(sim, movement);
+        }
+        checksums.push_back(state_checksum(sim));
+    }
+    return checksums;
+}
+
+/**
+ * @brief Check that a rock converts a scissors piece overlapping it across the edges of a toroidal world
+ *
+ * Runs one collision pass per overlap distance, from 1 up to just below the collision size, with the pair straddling
+ * the chosen edges and every other piece paper, so only the rock can convert the scissors piece.
+ * @param config - Configuration the density and piece size are taken from
+ * @param across_x - Place the pair across the left and right edges
+ * @param across_y - Place the pair across the top and bottom edges
+ * @param sim - Simulation to run the passes in
+ * @return - Returns first overlap distance that did not convert, or null if all converted
+ */
+static std::optional<int> first_missed_seam_overlap(
+    const RockPaperScissorsConfig& config, bool across_x, bool across_y, Simulation& sim)
+{
+    RockPaperScissorsConfig toroidal_config = config;
+    toroidal_config.world_topology = WorldTopology::e_toroidal;
+    const int piece_count = 20000;
+    reset_population(toroidal_config, piece_count, 1.0f, 1.0f, sim);
+    const auto width = static_cast<float>(sim.world.width);
+    const auto height = static_cast<float>(sim.world.height);
+    const int max_overlap = static_cast<int>(static_cast<float>(config.piece_size) * 0.8f);
+
+    for (int overlap = 1; overlap <= max_overlap; overlap++) {
+        for (int i = 0; i < piece_count; i++) {
+            set_piece_type(sim, i, PieceType::e_paper);
+        }
+        set_piece_type(sim, 0, PieceType::e_rock);
+        set_piece_type(sim, 1, PieceType::e_scissors);
+        const auto offset = static_cast<float>(overlap);
+        set_position(
+            sim,
+            0,
+            raylib::Vector2(across_x ? width - offset : width / 2.0f, across_y ? height - offset : height / 2.0f));
+        set_position(sim, 1, raylib::Vector2(across_x ? 0.0f : width / 2.0f, across_y ? 0.0f : height / 2.0f));
+        update_grid(sim, config.piece_size);
+        update_collisions(sim, config.piece_size);
+        sim.tick++;
+        if (sim.pieces[1].type != PieceType::e_rock) {
+            return overlap;
+        }
+    }
+    return {};
+}
+
+bool run_determinism_check(const RockPaperScissorsConfig& config)
+{
+    /**
+     * @brief Way of moving pieces whose checksums are compared against the single-threaded ones in the same topology
+     * and scalar type
+     */
+    struct Variant {
+        const char* name;
+        WorldTopology topology;
+        int thread_count;
+        int worker_processes;
+        bool is_fixed_point;
+    };
+    const WorldTopology bounded = WorldTopology::e_bounded;
+    const WorldTopology toroidal = WorldTopology::e_toroidal;
+    const Variant variants[] = {
+        { .name = "threads_1", .topology = bounded, .thread_count = 1, .worker_processes = 0 },
+        { .name = "threads_2", .topology = bounded, .thread_count = 2, .worker_processes = 0 },
+        { .name = "threads_8", .topology = bounded, .thread_count = 8, .worker_processes = 0 },
+        { .name = "threads_32", .topology = bounded, .thread_count = 32, .worker_processes = 0 },
+        { .name = "processes_3", .topology = bounded, .thread_count = 1, .worker_processes = 3 },
+        { .name = "toroidal_threads_1", .topology = toroidal, .thread_count = 1, .worker_processes = 0 },
+        { .name = "toroidal_threads_8", .topology = toroidal, .thread_count = 8, .worker_processes = 0 },
+        { .name = "toroidal_processes_3", .topology = toroidal, .thread_count = 1, .worker_processes = 3 },
+        { .name = "fixed_threads_1",
+          .topology = bounded,
+          .thread_count = 1,
+          .worker_processes = 0,
+          .is_fixed_point = true },
+        { .name = "fixed_threads_8",
+          .topology = bounded,
+          .thread_count = 8,
+          .worker_processes = 0,
+          .is_fixed_point = true },
+        { .name = "fixed_processes_3",
+          .topology = bounded,
+          .thread_count = 1,
+          .worker_processes = 3,
+          .is_fixed_point = true },
+    };
+    const int ticks = 100;
+    // Final checksum of the fixed point variants with the configuration in main.cpp. Fixed point ticks are the same on
+    // every platform and compiler, so a different checksum means a change to the simulation, not to the machine
+#if defined(RPS_COMPACT)
+    const uint64_t pinned_fixed_point_checksum = 0x2372a22648566c2e;
+#else
+    const uint64_t pinned_fixed_point_checksum = 0x25246b1386334eeb;
+#endif
+
+    bool is_deterministic = true;
+    // Indexed by topology, then by scalar type
+    std::array<std::array<std::vector<uint64_t>, 2>, 2> references;
+    std::printf("variant,ticks,final_checksum,first_mismatch_tick,status\n");
+    for (const Variant& variant : variants) {
+        RockPaperScissorsConfig variant_config = config;
+        variant_config.world_topology = variant.topology;
+        const std::vector<uint64_t> checksums = tick_checksums(
+            variant_config, variant.thread_count, variant.worker_processes, variant.is_fixed_point, ticks);
+        std::vector<uint64_t>& reference
+            = references[static_cast<int>(variant.topology)][variant.is_fixed_point ? 1 : 0];
+        if (reference.empty()) {
+            reference = checksums;
+        }
+        const auto mismatch = std::mismatch(checksums.begin(), checksums.end(), reference.begin());
+        const bool matches = mismatch.first == checksums.end();
+        const bool matches_pin = !variant.is_fixed_point || checksums.back() == pinned_fixed_point_checksum;
+        is_deterministic = is_deterministic && matches && matches_pin;
+        std::printf(
+            "%s,%d,%016llx,%d,%s\n",
+            variant.name,
+            ticks,
+            static_cast<unsigned long long>(checksums.back()),
+            matches ? -1 : static_cast<int>(mismatch.first - checksums.begin()) + 1,
+            !matches ? "mismatch" : (matches_pin ? "ok" : "pin_mismatch"));
+    }
+
+    /**
+     * @brief Edges of a toroidal world a colliding pair is placed across
+     */
+    struct Seam {
+        const char* name;
+        bool across_x;
+        bool across_y;
+    };
+    const Seam seams[] = {
+        { .name = "seam_x", .across_x = true, .across_y = false },
+        { .name = "seam_y", .across_x = false, .across_y = true },
+        { .name = "seam_corner", .across_x = true, .across_y = true },
+    };
+    for (const Seam& seam : seams) {
+        Simulation sim {};
+        const std::optional<int> missed = first_missed_seam_overlap(config, seam.across_x, seam.across_y, sim);
+        is_deterministic = is_deterministic && !missed.has_value();
+        std::printf(
+            "%s,%llu,%016llx,%d,%s\n",
+            seam.name,
+            static_cast<unsigned long long>(sim.tick),
+            static_cast<unsigned long long>(state_checksum(sim)),
+            missed.value_or(-1),
+            missed.has_value() ? "missed" : "ok");
+    }
+    return is_deterministic;
+}
+
+/**
+ * @brief Count heap allocations of steady-state ticks
+ * @param config - Configuration the density and movement are taken from
+ * @param thread_count - Number of threads movement and collisions are split over
+ * @param worker_processes - Number of domain worker processes, 0 to move pieces in this process
+ * @param ticks - Number of counted ticks
+ * @return - Returns number of allocations made by the counted ticks
+ */
+static uint64_t count_tick_allocations(
+    const RockPaperScissorsConfig& config, int thread_count, int worker_processes, int ticks)
+{
+    const int piece_count = 20000;
+    Simulation sim {};
+    reset_population(config, piece_count, 1.0f, 0.34f, sim);
+    util::ThreadPool thread_pool(thread_count);
+    sim.thread_pool = &thread_pool;
+    if (worker_processes > 0) {
+        // Same capacity as the game, so buffers start in shared memory and never restart the workers
+        start_domain_workers(sim, worker_processes, piece_count * 2);
+    }
+    // Targets are cached as in game
+    const Movement movement {
+        .model = config.movement_model,
+        .piece_size = config.piece_size,
+        .samples = config.piece_samples,
+        .max_acceleration = config.max_acceleration,
+        .damping = config.velocity_damping,
+        .target_refresh_ticks = config.target_refresh_ticks,
+        .target_distance_band = config.target_distance_band,
+    };
+
+    // Buffers grow to their steady-state size during the first ticks
+    for (int i = 0; i < c_warmup_ticks; i++) {
+        step(sim, movement);
+    }
+    const uint64_t allocations_start = util::allocation_count();
+    for (int i = 0; i < ticks; i++) {
+        step(sim, movement);
+    }
+    return util::allocation_count() - allocations_start;
+}
+
+/**
+ * @brief Count heap allocations of growing the piece count as the game does, a number of pieces per frame
+ * @param config - Configuration the density is taken from
+ * @param start_count - Number of pieces before growing
+ * @param piece_count - Number of pieces to grow to
+ * @param max_added - Maximum number of pieces added per frame
+ * @return - Returns number of allocations made by all frames but the first, which reserves the storage
+ */
+static uint64_t count_growth_allocations(
+    const RockPaperScissorsConfig& config, int start_count, int piece_count, int max_added)
+{
+    Simulation sim {};
+    check_memory_budget(
+        piece_count, estimate_memory_bytes(piece_count, 0), static_cast<size_t>(config.memory_budget_mb) * 1024 * 1024);
+    reset_population(config, start_count, 1.0f, 0.34f, sim);
+    update_piece_count(sim, piece_count, max_added);
+    const uint64_t allocations_start = util::allocation_count();
+    while (sim.pieces.size() < piece_count) {
+        update_piece_count(sim, piece_count, max_added);
+    }
+    return util::allocation_count() - allocations_start;
+}
+
+bool run_allocation_check(const RockPaperScissorsConfig& config)
+{
+#if !defined(RPS_TRACK_ALLOCATIONS)
+    throw std::runtime_error("Allocations are not counted, configure with -DRPS_TRACK_ALLOCATIONS=ON");
+#endif
+    /**
+     * @brief Way of moving pieces whose ticks are checked
+     */
+    struct Variant {
+        const char* name;
+        WorldTopology topology;
+        MovementModel movement_model;
+        int thread_count;
+        int worker_processes;
+    };
+    const WorldTopology bounded = WorldTopology::e_bounded;
+    const MovementModel direct = MovementModel::e_direct;
+    const Variant variants[] = {
+        { .name = "threads_1",
+          .topology = bounded,
+          .movement_model = direct,
+          .thread_count = 1,
+          .worker_processes = 0 },
+        { .name = "threads_8",
+          .topology = bounded,
+          .movement_model = direct,
+          .thread_count = 8,
+          .worker_processes = 0 },
+        { .name = "processes_3",
+          .topology = bounded,
+          .movement_model = direct,
+          .thread_count = 1,
+          .worker_processes = 3 },
+        { .name = "toroidal_steering_threads_8",
+          .topology = WorldTopology::e_toroidal,
+          .movement_model = MovementModel::e_steering,
+          .thread_count = 8,
+          .worker_processes = 0 },
+    };
+    const int ticks = 100;
+
+    bool is_allocation_free = true;
+    std::printf("variant,steps,allocations,status\n");
+    for (const Variant& variant : variants) {
+        RockPaperScissorsConfig variant_config = config;
+        variant_config.world_topology = variant.topology;
+        variant_config.movement_model = variant.movement_model;
+        const uint64_t allocations
+            = count_tick_allocations(variant_config, variant.thread_count, variant.worker_processes, ticks);
+        is_allocation_free = is_allocation_free && allocations == 0;
+        std::printf(
+            "%s,%d,%llu,%s\n",
+            variant.name,
+            ticks,
+            static_cast<unsigned long long>(allocations),
+            allocations == 0 ? "ok" : "allocates");
+    }
+
+    // Growing to a million pieces at the game's rate, one step per frame after the first
+    const int start_count = 1000;
+    const int piece_count = 1000000;
+    const int max_added = 10000;
+    const uint64_t growth_allocations = count_growth_allocations(config, start_count, piece_count, max_added);
+    is_allocation_free = is_allocation_free && growth_allocations == 0;
+    std::printf(
+        "growth_1m,%d,%llu,%s\n",
+        (piece_count - start_count + max_added - 1) / max_added - 1,
+        static_cast<unsigned long long>(growth_allocations),
+        growth_allocations == 0 ? "ok" : "allocates");
+    return is_allocation_free;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "rock_paper_scissors.hpp"
+
+namespace rps {
+
+/**
+ * @brief Run headless late-game ticks for populations dominated by one piece type and print their timings
+ * @param config - Configuration the benchmark density and movement are taken from
+ */
+void run_benchmark(const RockPaperScissorsConfig& config);
+
+/**
+ * @brief Sweep thread count by piece count and print tick time, speedup, efficiency and memory bandwidth
+ *
+ * Prints CSV, one line per configuration. Speedup and efficiency are relative to one thread at the same piece count.
+ * Bandwidth is estimated from the bytes a tick touches per piece, and measured from LLC misses where counters are
+ * available.
+ * Movement and collisions are split over threads, so the serial grid rebuild is where scaling stops.
+ * @param config - Configuration the density and movement are taken from
+ */
+void run_scaling_benchmark(const RockPaperScissorsConfig& config);
+
+/**
+ * @brief Run the same fixed-seed ticks on 1, 2, 8 and 32 threads and on domain worker processes, comparing the state
+ * checksums after every tick, in a bounded and a toroidal world
+ *
+ * Prints CSV, one line per variant with its final checksum and the first tick that differs from one thread, if any.
+ * Variants on util::Fixed also compare their final checksum with one pinned in the source, which is the same on every
+ * platform. Then checks that pairs overlapping across the edges of a toroidal world collide, one line per edge with
+ * the number of collision passes and the first overlap distance that did not convert, if any.
+ * @param config - Configuration the density and movement are taken from
+ * @return - Returns false if any variant differs, a fixed point checksum is not the pinned one or any seam pair did not
+ * convert
+ * @throws std::runtime_error if the domain workers cannot be started
+ */
+bool run_determinism_check(const RockPaperScissorsConfig& config);
+
+/**
+ * @brief Run steady-state ticks on one and eight threads and on domain worker processes, counting heap allocations
+ *
+ * Prints CSV, one line per variant with the number of allocations made by its ticks after warming up. Then grows the
+ * piece count to a million over several frames and prints the allocations of the frames after the first.
+ * @param config - Configuration the density and movement are taken from
+ * @return - Returns false if any variant allocates
+ * @throws std::runtime_error if allocations are not counted in this build or the domain workers cannot be started
+ */
+bool run_allocation_check(const RockPaperScissorsConfig& config);
+
+/**
+ * @brief Run fixed-seed headless scenarios and compare their ticks per second against the baseline file
+ *
+ * Prints one CSV line per scenario with the baseline, the measured rate, the change and a status of ok, slower,
+ * faster or new (not in the baseline). Without a baseline file every scenario is new.
+ * @param config - Configuration with the baseline path and tolerance, density and movement are taken from it
+ * @return - Returns false if any scenario is slower than the baseline by more than the tolerance
+ * @throws std::runtime_error if the baseline cannot be read
+ */
+bool run_perf_check(const RockPaperScissorsConfig& config);
+
+/**
+ * @brief Run the perf check scenarios and write their ticks per second as the new baseline file
+ * @param config - Configuration with the baseline path, density and movement are taken from it
+ * @throws std::runtime_error if the baseline cannot be written
+ */
+void write_perf_baseline(const RockPaperScissorsConfig& config);
+
+}
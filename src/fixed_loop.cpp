@@ -1,5 +1,6 @@
 #include "fixed_loop.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 
@@ -15,23 +16,6 @@ FixedLoop::FixedLoop(float rate)
     m_blend = 0;
 }
 
-void FixedLoop::update(int max_loops, std::optional<std::function<void()>> callback)
-{
-    update_state();
-    int loop_count = 0;
-    while (m_is_ready) {
-        if (callback.has_value()) {
-            std::invoke(callback.value());
-        }
-        update_state();
-        loop_count++;
-        if (loop_count >= max_loops) {
-            reset();
-            break;
-        }
-    }
-}
-
 void FixedLoop::set_rate(float rate)
 {
     m_rate = static_cast<int64_t>((static_cast<double>(1.0f / rate)) * static_cast<int64_t>(1000000000));
@@ -42,6 +26,11 @@ float FixedLoop::blend() const
     return static_cast<float>(m_blend);
 }
 
+std::chrono::nanoseconds FixedLoop::time_to_next_step() const
+{
+    return std::chrono::nanoseconds(std::max<int64_t>(0, m_rate - m_delta));
+}
+
 void FixedLoop::reset()
 {
     m_start = std::chrono::steady_clock::now();
@@ -1,8 +1,7 @@
 #pragma once
 
 #include <chrono>
-#include <functional>
-#include <optional>
+#include <cstdint>
 
 namespace util {
 
@@ -41,10 +40,33 @@ public:
      */
     [[nodiscard]] float blend() const;
 
+    /**
+     * @brief Get time left until the next step is due, as of the last update
+     * @return - Returns time until next step
+     */
+    [[nodiscard]] std::chrono::nanoseconds time_to_next_step() const;
+
     /**
      * @brief Update loop and callback
+     * @tparam Callback - Callable invoked once per step, taken by reference so no copy or allocation is made
+     * @param max_loops - Maximum number of steps before the loop is reset
+     * @param callback - Step callback
      */
-    void update(int max_loops, std::optional<std::function<void()>> callback);
+    template <typename Callback>
+    void update(int max_loops, Callback&& callback)
+    {
+        update_state();
+        int loop_count = 0;
+        while (m_is_ready) {
+            callback();
+            update_state();
+            loop_count++;
+            if (loop_count >= max_loops) {
+                reset();
+                break;
+            }
+        }
+    }
 
 private:
     std::chrono::time_point<std::chrono::steady_clock> m_start;
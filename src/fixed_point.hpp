@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cmath>
+#include <compare>
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief Signed fixed-point number with 16 fractional bits
+ *
+ * Results are exact integer arithmetic, so they are bit-identical for every compiler and platform, including WASM.
+ * The value is stored in 64 bits (Q47.16) instead of 32 so squared distances across large worlds do not overflow.
+ * Conversions from float truncate towards zero, conversions to float round to nearest.
+ */
+class Fixed {
+
+public:
+    static constexpr int c_fraction_bits = 16;
+
+    /**
+     * @brief Constructs Fixed with a value of 0
+     */
+    constexpr Fixed()
+        : m_raw(0)
+    {
+    }
+
+    /**
+     * @brief Construct Fixed from an integer
+     * @param value - Integer value
+     */
+    constexpr explicit Fixed(int value)
+        : m_raw(static_cast<int64_t>(value) << c_fraction_bits)
+    {
+    }
+
+    /**
+     * @brief Construct Fixed from a float
+     * @param value - Float value, scaling by a power of two is exact so only the truncation rounds
+     */
+    constexpr explicit Fixed(float value)
+        : m_raw(static_cast<int64_t>(value * static_cast<float>(c_one)))
+    {
+    }
+
+    /**
+     * @brief Construct Fixed from its raw representation
+     * @param raw - Value scaled by 2^16
+     * @return - Returns fixed-point number
+     */
+    static constexpr Fixed from_raw(int64_t raw)
+    {
+        Fixed result;
+        result.m_raw = raw;
+        return result;
+    }
+
+    /**
+     * @brief Get raw representation
+     * @return - Returns value scaled by 2^16
+     */
+    [[nodiscard]] constexpr int64_t raw() const
+    {
+        return m_raw;
+    }
+
+    constexpr explicit operator float() const
+    {
+        return static_cast<float>(m_raw) / static_cast<float>(c_one);
+    }
+
+    constexpr auto operator<=>(const Fixed&) const = default;
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b)
+    {
+        return from_raw(a.m_raw + b.m_raw);
+    }
+
+    friend constexpr Fixed operator-(Fixed a, Fixed b)
+    {
+        return from_raw(a.m_raw - b.m_raw);
+    }
+
+    friend constexpr Fixed operator-(Fixed a)
+    {
+        return from_raw(-a.m_raw);
+    }
+
+    friend constexpr Fixed operator*(Fixed a, Fixed b)
+    {
+        // Integer and fraction parts of a are multiplied separately so the product needs no 128-bit intermediate,
+        // the result is rounded down
+        const int64_t integer = a.m_raw >> c_fraction_bits;
+        const int64_t fraction = a.m_raw & (c_one - 1);
+        return from_raw(integer * b.m_raw + ((fraction * b.m_raw) >> c_fraction_bits));
+    }
+
+    friend constexpr Fixed operator/(Fixed a, Fixed b)
+    {
+        // Quotient and remainder are scaled separately so the dividend is never shifted out of range, the result is
+        // truncated towards zero
+        const int64_t quotient = a.m_raw / b.m_raw;
+        const int64_t remainder = a.m_raw % b.m_raw;
+        return from_raw(quotient * c_one + remainder * c_one / b.m_raw);
+    }
+
+    constexpr Fixed& operator+=(Fixed other)
+    {
+        return *this = *this + other;
+    }
+
+    constexpr Fixed& operator-=(Fixed other)
+    {
+        return *this = *this - other;
+    }
+
+    constexpr Fixed& operator*=(Fixed other)
+    {
+        return *this = *this * other;
+    }
+
+    constexpr Fixed& operator/=(Fixed other)
+    {
+        return *this = *this / other;
+    }
+
+    /**
+     * @brief Get absolute value
+     * @param value - Fixed-point number
+     * @return - Returns absolute value
+     */
+    friend constexpr Fixed abs(Fixed value)
+    {
+        return value.m_raw < 0 ? -value : value;
+    }
+
+    /**
+     * @brief Round down to an integer
+     * @param value - Fixed-point number
+     * @return - Returns largest integer not greater than value
+     */
+    friend constexpr Fixed floor(Fixed value)
+    {
+        return from_raw(value.m_raw & ~(c_one - 1));
+    }
+
+    /**
+     * @brief Round to the nearest integer, halfway cases away from zero like std::round
+     * @param value - Fixed-point number
+     * @return - Returns nearest integer
+     */
+    friend constexpr Fixed round(Fixed value)
+    {
+        const Fixed half = from_raw(c_one / 2);
+        return value.m_raw < 0 ? -floor(-value + half) : floor(value + half);
+    }
+
+    /**
+     * @brief Get square root, rounded down
+     * @param value - Fixed-point number
+     * @return - Returns square root, 0 for negative values
+     */
+    friend Fixed sqrt(Fixed value)
+    {
+        if (value.m_raw <= 0) {
+            return Fixed();
+        }
+        // sqrt(raw * 2^16) keeps all fractional bits, values too large to shift lose the lowest 8 of them instead
+        const auto raw = static_cast<uint64_t>(value.m_raw);
+        if (raw < (uint64_t(1) << (63 - c_fraction_bits))) {
+            return from_raw(static_cast<int64_t>(isqrt(raw << c_fraction_bits)));
+        }
+        return from_raw(static_cast<int64_t>(isqrt(raw) << (c_fraction_bits / 2)));
+    }
+
+private:
+    static constexpr int64_t c_one = int64_t(1) << c_fraction_bits;
+
+    int64_t m_raw;
+
+    /**
+     * @brief Get integer square root of a value below 2^63
+     *
+     * The double square root is only an estimate that is corrected with integer arithmetic, so the result is exact
+     * even where double rounding differs between platforms.
+     * @param value - Integer
+     * @return - Returns largest integer whose square is not greater than value
+     */
+    static uint64_t isqrt(uint64_t value)
+    {
+        auto result = static_cast<uint64_t>(std::sqrt(static_cast<double>(value)));
+        while (result * result > value) {
+            result--;
+        }
+        while ((result + 1) * (result + 1) <= value) {
+            result++;
+        }
+        return result;
+    }
+};
+
+}
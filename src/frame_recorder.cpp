@@ -0,0 +1,173 @@
+#include "frame_recorder.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define FRAME_RECORDER_SUPPORTED
+#endif
+
+namespace util {
+
+// Mapping grows in steps of this size to keep remaps rare
+static const size_t c_growth_size = 64 * 1024 * 1024;
+
+static size_t frame_size(uint32_t piece_count)
+{
+    size_t types_size = (static_cast<size_t>(piece_count) + 3) & ~static_cast<size_t>(3);
+    return sizeof(FrameHeader) + types_size + static_cast<size_t>(piece_count) * sizeof(float) * 2;
+}
+
+FrameRecorder::FrameRecorder()
+{
+    m_fd = -1;
+    m_data = nullptr;
+    m_capacity = 0;
+    m_size = 0;
+    m_frame_count = 0;
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    // Errors cannot be reported from the destructor, close explicitly to get them
+    try {
+        close();
+    }
+    catch (std::runtime_error&) {
+    }
+}
+
+bool FrameRecorder::is_open() const
+{
+    return m_data != nullptr;
+}
+
+#if defined(FRAME_RECORDER_SUPPORTED)
+
+void FrameRecorder::open(const std::string& path)
+{
+    close();
+
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+        throw std::runtime_error("Unable to open frame recording: " + path + ": " + std::strerror(errno));
+    }
+    m_size = sizeof(FrameFileHeader);
+    m_frame_count = 0;
+    try {
+        reserve(c_growth_size);
+    }
+    catch (std::runtime_error&) {
+        ::close(m_fd);
+        m_fd = -1;
+        throw;
+    }
+
+    FrameFileHeader header {};
+    std::memcpy(header.magic, "RPSFRAME", sizeof(header.magic));
+    header.version = 1;
+    header.frame_header_size = sizeof(FrameHeader);
+    std::memcpy(m_data, &header, sizeof(header));
+}
+
+void FrameRecorder::close()
+{
+    if (m_data != nullptr) {
+        publish_frames();
+        munmap(m_data, m_capacity);
+        m_data = nullptr;
+    }
+    int trim_error = 0;
+    if (m_fd >= 0) {
+        if (ftruncate(m_fd, static_cast<off_t>(m_size)) != 0) {
+            trim_error = errno;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_capacity = 0;
+    if (trim_error != 0) {
+        // The header is already written, readers stop at its data size and ignore the unused space after it
+        throw std::runtime_error(std::string("Unable to trim frame recording: ") + std::strerror(trim_error));
+    }
+}
+
+void FrameRecorder::reserve(size_t size)
+{
+    if (size <= m_capacity) {
+        return;
+    }
+    size_t new_capacity = ((size + c_growth_size - 1) / c_growth_size) * c_growth_size;
+    // The old mapping stays valid until the new one exists, so a failure leaves the recorded frames intact
+    if (ftruncate(m_fd, static_cast<off_t>(new_capacity)) != 0) {
+        throw std::runtime_error(std::string("Unable to grow frame recording: ") + std::strerror(errno));
+    }
+    void* data = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error(std::string("Unable to map frame recording: ") + std::strerror(errno));
+    }
+    if (m_data != nullptr) {
+        munmap(m_data, m_capacity);
+    }
+    m_data = static_cast<std::byte*>(data);
+    m_capacity = new_capacity;
+}
+
+#else
+
+void FrameRecorder::open(const std::string& path)
+{
+    throw std::runtime_error("Frame recording is not supported on this platform: " + path);
+}
+
+void FrameRecorder::close()
+{
+}
+
+void FrameRecorder::reserve(size_t size)
+{
+}
+
+#endif
+
+void FrameRecorder::publish_frames()
+{
+    auto* header = reinterpret_cast<FrameFileHeader*>(m_data);
+    header->frame_count = m_frame_count;
+    header->data_size = m_size;
+}
+
+FrameColumns FrameRecorder::append_frame(uint64_t tick, uint32_t piece_count)
+{
+    // The previous frame was filled by the caller since it was appended. Counting it in the header now keeps the file
+    // readable up to it if the process dies without closing, and never counts a frame that is still being filled
+    publish_frames();
+
+    size_t size = frame_size(piece_count);
+    reserve(m_size + size);
+
+    std::byte* frame = m_data + m_size;
+    FrameHeader header {
+        .tick = tick,
+        .piece_count = piece_count,
+        .frame_size = static_cast<uint32_t>(size),
+    };
+    std::memcpy(frame, &header, sizeof(header));
+    m_size += size;
+    m_frame_count++;
+
+    std::byte* types = frame + sizeof(FrameHeader);
+    std::byte* pos_x = types + ((static_cast<size_t>(piece_count) + 3) & ~static_cast<size_t>(3));
+    std::byte* pos_y = pos_x + static_cast<size_t>(piece_count) * sizeof(float);
+    return FrameColumns {
+        .types = reinterpret_cast<uint8_t*>(types),
+        .pos_x = reinterpret_cast<float*>(pos_x),
+        .pos_y = reinterpret_cast<float*>(pos_y),
+    };
+}
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace util {
+
+/**
+ * @brief Fixed-size header at the start of a frame recording file
+ */
+struct FrameFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t frame_header_size;
+    uint64_t frame_count;
+    uint64_t data_size;
+};
+
+/**
+ * @brief Fixed-size header preceding the columns of each recorded frame
+ *
+ * Columns follow the header in order: types (uint8), x positions (float), y positions (float).
+ * The type column is padded to a multiple of 4 bytes so the float columns stay aligned.
+ */
+struct FrameHeader {
+    uint64_t tick;
+    uint32_t piece_count;
+    uint32_t frame_size;
+};
+
+/**
+ * @brief Column pointers into the mapped file for the frame currently being written
+ */
+struct FrameColumns {
+    uint8_t* types;
+    float* pos_x;
+    float* pos_y;
+};
+
+/**
+ * @brief Append-only, memory-mapped writer of simulation frames
+ */
+class FrameRecorder {
+
+public:
+    FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    ~FrameRecorder();
+
+    /**
+     * @brief Create (or truncate) recording file and map it
+     * @param path - Path of recording file
+     * @throws std::runtime_error if the file cannot be created or mapped
+     */
+    void open(const std::string& path);
+
+    /**
+     * @brief Finalize header, trim file to written size and unmap it
+     * @throws std::runtime_error if the file cannot be trimmed, it is closed anyway
+     */
+    void close();
+
+    /**
+     * @brief Check if a recording file is open
+     * @return - Returns true if recording
+     */
+    [[nodiscard]] bool is_open() const;
+
+    /**
+     * @brief Reserve the next frame in the file
+     *
+     * The file header is updated to count every frame appended before this one, so the file stays readable if the
+     * process ends without closing it.
+     * @param tick - Simulation tick of frame
+     * @param piece_count - Number of pieces in frame
+     * @return - Returns pointers to the frame columns to be filled in place by the caller
+     * @throws std::runtime_error if the file cannot be grown, the frames recorded so far stay mapped
+     */
+    FrameColumns append_frame(uint64_t tick, uint32_t piece_count);
+
+private:
+    int m_fd;
+    std::byte* m_data;
+    size_t m_capacity;
+    size_t m_size;
+    uint64_t m_frame_count;
+
+    void reserve(size_t size);
+
+    /**
+     * @brief Write the number of frames and the data size so far to the file header
+     */
+    void publish_frames();
+};
+
+}
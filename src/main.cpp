@@ -1,23 +1,102 @@
 #include <iostream>
+#include <string_view>
 
+#include "benchmark.hpp"
 #include "rock_paper_scissors.hpp"
 
-int main()
+int main(int argc, char* argv[])
 {
     // Initial simulation configuration
     rps::RockPaperScissorsConfig config {
         .screen_width = 1200,
         .screen_height = 800,
+        .world_width = 1200,
+        .world_height = 800,
+        .world_topology = rps::WorldTopology::e_bounded,
         .simulation_rate = 45,
+        .max_fps = 60,
         .piece_size = 28,
         .piece_count = 125,
         .volume = 0.5f,
         .piece_samples = 10,
+        .movement_model = rps::MovementModel::e_direct,
+        .max_acceleration = 0.5f,
+        .velocity_damping = 0.1f,
+        .target_refresh_ticks = 8,
+        .target_distance_band = 2.0f,
+        .spawn_placement = rps::SpawnPlacement::e_uniform,
+        .worker_processes = 0,
+        .record_interval = 10,
+        .record_path = "frames.rpsf",
+        .trace_at_start = false,
+        .trace_seconds = 5.0f,
+        .trace_path = "trace.json",
+        .memory_budget_mb = 4096,
+        .perf_baseline_path = "perf_baseline.csv",
+        .perf_tolerance = 0.15f,
     };
 
-    // Run game
+    enum class Mode {
+        e_game,
+        e_benchmark,
+        e_scaling,
+        e_perf_check,
+        e_perf_baseline,
+        e_verify_determinism,
+        e_verify_allocations,
+    };
+    Mode mode = Mode::e_game;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg(argv[i]);
+        if (arg == "--benchmark") {
+            mode = Mode::e_benchmark;
+        }
+        else if (arg == "--scaling") {
+            mode = Mode::e_scaling;
+        }
+        else if (arg == "--perf-check") {
+            mode = Mode::e_perf_check;
+        }
+        else if (arg == "--perf-baseline") {
+            mode = Mode::e_perf_baseline;
+        }
+        else if (arg == "--verify-determinism") {
+            mode = Mode::e_verify_determinism;
+        }
+        else if (arg == "--verify-allocations") {
+            mode = Mode::e_verify_allocations;
+        }
+        else if (arg == "--trace") {
+            config.trace_at_start = true;
+        }
+        else {
+            std::cerr << "[ERROR] Unknown argument: " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Run game, or time simulation ticks without a window
     try {
-        rps::run(config);
+        switch (mode) {
+        case Mode::e_game:
+            rps::run(config);
+            break;
+        case Mode::e_benchmark:
+            rps::run_benchmark(config);
+            break;
+        case Mode::e_scaling:
+            rps::run_scaling_benchmark(config);
+            break;
+        case Mode::e_perf_check:
+            return rps::run_perf_check(config) ? EXIT_SUCCESS : EXIT_FAILURE;
+        case Mode::e_perf_baseline:
+            rps::write_perf_baseline(config);
+            break;
+        case Mode::e_verify_determinism:
+            return rps::run_determinism_check(config) ? EXIT_SUCCESS : EXIT_FAILURE;
+        case Mode::e_verify_allocations:
+            return rps::run_allocation_check(config) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
     }
     catch (std::exception& e) {
         std::cerr << "[ERROR] " << e.what() << std::endl;
@@ -0,0 +1,190 @@
+#include "perf_counters.hpp"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PERF_COUNTERS_SUPPORTED
+#endif
+
+namespace util {
+
+const char* perf_event_name(PerfEvent event)
+{
+    switch (event) {
+    case PerfEvent::e_cycles:
+        return "cycles";
+    case PerfEvent::e_instructions:
+        return "instructions";
+    case PerfEvent::e_l1d_misses:
+        return "L1D misses";
+    case PerfEvent::e_llc_misses:
+        return "LLC misses";
+    case PerfEvent::e_branch_misses:
+        return "branch misses";
+    }
+    return "";
+}
+
+#if defined(PERF_COUNTERS_SUPPORTED)
+
+/**
+ * @brief Set perf type and config of a hardware event
+ * @param event - Hardware event
+ * @param attr - Perf event attributes to update
+ */
+static void set_perf_event_config(PerfEvent event, perf_event_attr& attr)
+{
+    const uint64_t read_miss = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    switch (event) {
+    case PerfEvent::e_cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        return;
+    case PerfEvent::e_instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        return;
+    case PerfEvent::e_l1d_misses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+        return;
+    case PerfEvent::e_llc_misses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_LL | read_miss;
+        return;
+    case PerfEvent::e_branch_misses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        return;
+    }
+}
+
+PerfCounters::PerfCounters()
+{
+    for (int i = 0; i < c_perf_event_count; i++) {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        set_perf_event_config(static_cast<PerfEvent>(i), attr);
+        attr.disabled = 1;
+        // Children are counted so worker threads and processes started later are included
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        m_fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (m_fds[i] < 0 && m_error.empty()) {
+            m_error = std::string("Unable to open ") + perf_event_name(static_cast<PerfEvent>(i))
+                + " counter: " + std::strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::start()
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::reset()
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        }
+    }
+}
+
+std::optional<double> PerfCounters::read(PerfEvent event) const
+{
+    const int fd = m_fds[static_cast<int>(event)];
+    if (fd < 0) {
+        return {};
+    }
+    // Value, time enabled and time running
+    uint64_t values[3] {};
+    if (::read(fd, values, sizeof(values)) != sizeof(values)) {
+        return {};
+    }
+    if (values[2] == 0) {
+        // Never scheduled on the hardware while enabled, usually because other events took every counter
+        if (values[1] != 0) {
+            return {};
+        }
+        return 0.0;
+    }
+    return static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+    m_fds.fill(-1);
+    m_error = "Hardware counters are not supported on this platform";
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::start()
+{
+}
+
+void PerfCounters::stop()
+{
+}
+
+void PerfCounters::reset()
+{
+}
+
+std::optional<double> PerfCounters::read(PerfEvent event) const
+{
+    return {};
+}
+
+#endif
+
+bool PerfCounters::is_available() const
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::string& PerfCounters::error() const
+{
+    return m_error;
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace util {
+
+/**
+ * @brief Hardware events counted by PerfCounters
+ */
+enum class PerfEvent {
+    e_cycles,
+    e_instructions,
+    e_l1d_misses,
+    e_llc_misses,
+    e_branch_misses,
+};
+
+inline constexpr int c_perf_event_count = 5;
+
+/**
+ * @brief Get short name of hardware event
+ * @param event - Hardware event
+ * @return - Returns event name
+ */
+const char* perf_event_name(PerfEvent event);
+
+/**
+ * @brief Hardware performance counters of the calling thread and the threads and processes it creates afterwards
+ *
+ * Counts accumulate over every start and stop pair until reset. Counters the CPU, kernel or permissions do not
+ * provide are skipped, only Linux provides any.
+ */
+class PerfCounters {
+
+public:
+    /**
+     * @brief Open all available counters, stopped and reset
+     */
+    PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters();
+
+    /**
+     * @brief Check if any counter could be opened
+     * @return - Returns true if at least one event is counted
+     */
+    [[nodiscard]] bool is_available() const;
+
+    /**
+     * @brief Get reason the first unavailable counter could not be opened
+     * @return - Returns error message, empty if every counter is available
+     */
+    [[nodiscard]] const std::string& error() const;
+
+    /**
+     * @brief Start counting
+     */
+    void start();
+
+    /**
+     * @brief Stop counting, keeping the counts
+     */
+    void stop();
+
+    /**
+     * @brief Set all counts to zero
+     */
+    void reset();
+
+    /**
+     * @brief Read count of an event, scaled up for the time the kernel multiplexed it out
+     * @param event - Hardware event
+     * @return - Returns count or null if the event is not available
+     */
+    [[nodiscard]] std::optional<double> read(PerfEvent event) const;
+
+private:
+    std::array<int, c_perf_event_count> m_fds;
+    std::string m_error;
+};
+
+}
@@ -0,0 +1,157 @@
+#include "process_group.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define PROCESS_GROUP_SUPPORTED
+#endif
+
+namespace util {
+
+static const char c_command_step = 's';
+static const char c_command_quit = 'q';
+static const char c_reply_done = 'd';
+
+ProcessGroup::ProcessGroup()
+{
+    m_shared = nullptr;
+    m_shared_size = 0;
+}
+
+ProcessGroup::~ProcessGroup()
+{
+    stop();
+}
+
+bool ProcessGroup::is_running() const
+{
+    return !m_pids.empty();
+}
+
+void* ProcessGroup::shared() const
+{
+    return m_shared;
+}
+
+size_t ProcessGroup::shared_size() const
+{
+    return m_shared_size;
+}
+
+int ProcessGroup::worker_count() const
+{
+    return static_cast<int>(m_pids.size());
+}
+
+#if defined(PROCESS_GROUP_SUPPORTED)
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+void ProcessGroup::start(int worker_count, size_t shared_size, TaskFunc task, void* context)
+{
+    stop();
+
+    void* shared = mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        throw std::runtime_error(std::string("Unable to map worker shared memory: ") + std::strerror(errno));
+    }
+    m_shared = shared;
+    m_shared_size = shared_size;
+
+    for (int i = 0; i < worker_count; i++) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            stop();
+            throw std::runtime_error(std::string("Unable to create worker socket: ") + std::strerror(errno));
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            ::close(sockets[0]);
+            ::close(sockets[1]);
+            stop();
+            throw std::runtime_error(std::string("Unable to fork worker: ") + std::strerror(errno));
+        }
+
+        if (pid == 0) {
+            // Worker process, never returns to the caller
+            ::close(sockets[0]);
+            for (int socket : m_sockets) {
+                ::close(socket);
+            }
+            char command;
+            while (recv(sockets[1], &command, 1, 0) == 1 && command == c_command_step) {
+                task(context, i, worker_count, shared);
+                if (send(sockets[1], &c_reply_done, 1, MSG_NOSIGNAL) != 1) {
+                    break;
+                }
+            }
+            _exit(0);
+        }
+
+        ::close(sockets[1]);
+        m_pids.push_back(pid);
+        m_sockets.push_back(sockets[0]);
+    }
+}
+
+void ProcessGroup::stop()
+{
+    for (int socket : m_sockets) {
+        send(socket, &c_command_quit, 1, MSG_NOSIGNAL);
+        ::close(socket);
+    }
+    for (int pid : m_pids) {
+        waitpid(pid, nullptr, 0);
+    }
+    m_sockets.clear();
+    m_pids.clear();
+    if (m_shared != nullptr) {
+        munmap(m_shared, m_shared_size);
+        m_shared = nullptr;
+        m_shared_size = 0;
+    }
+}
+
+void ProcessGroup::step()
+{
+    for (int socket : m_sockets) {
+        if (send(socket, &c_command_step, 1, MSG_NOSIGNAL) != 1) {
+            throw std::runtime_error("Worker process exited");
+        }
+    }
+    for (int socket : m_sockets) {
+        char reply;
+        if (recv(socket, &reply, 1, 0) != 1 || reply != c_reply_done) {
+            throw std::runtime_error("Worker process exited");
+        }
+    }
+}
+
+#else
+
+void ProcessGroup::start(int worker_count, size_t shared_size, TaskFunc task, void* context)
+{
+    throw std::runtime_error("Worker processes are not supported on this platform");
+}
+
+void ProcessGroup::stop()
+{
+}
+
+void ProcessGroup::step()
+{
+}
+
+#endif
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+
+/**
+ * @brief Group of forked worker processes that run a step function on memory shared with the parent
+ *
+ * Each worker is connected to the parent by a Unix socket pair used to start a step and report its completion.
+ * Only the shared memory region is visible to both sides after the fork, so any per-step input for the workers has
+ * to be written there.
+ */
+class ProcessGroup {
+
+public:
+    ProcessGroup();
+
+    ProcessGroup(const ProcessGroup&) = delete;
+
+    ProcessGroup& operator=(const ProcessGroup&) = delete;
+
+    ~ProcessGroup();
+
+    /**
+     * @brief Map shared memory and fork worker processes
+     * @tparam Func - Callable taking (int worker_index, int worker_count, void* shared), run in the workers only
+     * @param worker_count - Number of processes to fork
+     * @param shared_size - Size of memory region shared with workers in bytes
+     * @param func - Step callback
+     * @throws std::runtime_error if memory cannot be mapped or processes cannot be created
+     */
+    template <typename Func>
+    void start(int worker_count, size_t shared_size, Func&& func)
+    {
+        start(
+            worker_count,
+            shared_size,
+            [](void* context, int worker_index, int worker_count, void* shared) {
+                (*static_cast<std::remove_reference_t<Func>*>(context))(worker_index, worker_count, shared);
+            },
+            const_cast<void*>(static_cast<const void*>(&func)));
+    }
+
+    /**
+     * @brief Tell workers to exit, wait for them and unmap shared memory
+     */
+    void stop();
+
+    /**
+     * @brief Run one step on every worker and wait for all of them to finish
+     * @throws std::runtime_error if a worker exited
+     */
+    void step();
+
+    /**
+     * @brief Check if workers are running
+     * @return - Returns true if started
+     */
+    [[nodiscard]] bool is_running() const;
+
+    /**
+     * @brief Get memory shared with workers
+     * @return - Returns pointer to start of shared region
+     */
+    [[nodiscard]] void* shared() const;
+
+    /**
+     * @brief Get size of memory shared with workers
+     * @return - Returns size in bytes
+     */
+    [[nodiscard]] size_t shared_size() const;
+
+    /**
+     * @brief Get number of worker processes
+     * @return - Returns worker count
+     */
+    [[nodiscard]] int worker_count() const;
+
+private:
+    using TaskFunc = void (*)(void*, int, int, void*);
+
+    std::vector<int> m_pids;
+    std::vector<int> m_sockets;
+    void* m_shared;
+    size_t m_shared_size;
+
+    void start(int worker_count, size_t shared_size, TaskFunc task, void* context);
+};
+
+}
@@ -0,0 +1,218 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace util {
+
+static const int c_max_zones = 32;
+// Number of most recent samples kept per zone and thread
+static const int c_ring_size = 256;
+
+/**
+ * @brief Zone sample recorded while tracing, times are relative to the start of the trace
+ */
+struct TraceEvent {
+    int zone;
+    int64_t start_ns;
+    int64_t duration_ns;
+};
+
+/**
+ * @brief Ring buffers of recent samples of every zone and trace events written by one thread
+ */
+struct ThreadSamples {
+    std::array<std::array<std::atomic<int64_t>, c_ring_size>, c_max_zones> samples;
+    // Total number of samples written per zone, the ring position is this modulo the ring size
+    std::array<std::atomic<uint32_t>, c_max_zones> counts;
+
+    // Preallocated while tracing, events past its size are dropped
+    std::vector<TraceEvent> trace_events;
+    std::atomic<size_t> trace_count;
+};
+
+static std::mutex g_mutex;
+static std::array<const char*, c_max_zones> g_zone_names {};
+static int g_zone_count = 0;
+static std::vector<std::unique_ptr<ThreadSamples>> g_threads;
+static thread_local ThreadSamples* t_samples = nullptr;
+
+static std::atomic<bool> g_tracing = false;
+static std::chrono::time_point<std::chrono::steady_clock> g_trace_start;
+static size_t g_trace_capacity = 0;
+
+/**
+ * @brief Get buffers of the calling thread, allocating them on first use
+ * @return - Returns thread buffers
+ */
+static ThreadSamples& thread_samples()
+{
+    if (t_samples == nullptr) {
+        // Buffers are allocated once per thread, the first sample of a thread is the only one that allocates
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_threads.push_back(std::make_unique<ThreadSamples>());
+        t_samples = g_threads.back().get();
+        t_samples->trace_events.resize(g_trace_capacity);
+    }
+    return *t_samples;
+}
+
+int profile_zone(const char* name)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (int i = 0; i < g_zone_count; i++) {
+        if (std::strcmp(g_zone_names[i], name) == 0) {
+            return i;
+        }
+    }
+    if (g_zone_count >= c_max_zones) {
+        throw std::runtime_error(std::string("Too many profiler zones: ") + name);
+    }
+    g_zone_names[g_zone_count] = name;
+    return g_zone_count++;
+}
+
+void profile_record(int zone, std::chrono::nanoseconds duration)
+{
+    ThreadSamples& thread = thread_samples();
+    const uint32_t count = thread.counts[zone].load(std::memory_order_relaxed);
+    thread.samples[zone][count % c_ring_size].store(duration.count(), std::memory_order_relaxed);
+    thread.counts[zone].store(count + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Record a trace event into the buffer of the calling thread
+ * @param zone - Zone id
+ * @param start - Start time of sample
+ * @param duration - Duration of sample
+ */
+static void trace_record(
+    int zone, std::chrono::time_point<std::chrono::steady_clock> start, std::chrono::nanoseconds duration)
+{
+    ThreadSamples& thread = thread_samples();
+    const size_t count = thread.trace_count.load(std::memory_order_relaxed);
+    if (count >= thread.trace_events.size()) {
+        return;
+    }
+    thread.trace_events[count] = TraceEvent {
+        .zone = zone,
+        .start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start - g_trace_start).count(),
+        .duration_ns = duration.count(),
+    };
+    thread.trace_count.store(count + 1, std::memory_order_release);
+}
+
+void profile_trace_start(size_t events_per_thread)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_trace_capacity = events_per_thread;
+    for (const std::unique_ptr<ThreadSamples>& thread : g_threads) {
+        thread->trace_events.resize(events_per_thread);
+        thread->trace_count.store(0, std::memory_order_relaxed);
+    }
+    g_trace_start = std::chrono::steady_clock::now();
+    g_tracing.store(true, std::memory_order_release);
+}
+
+size_t profile_trace_stop(const std::string& path)
+{
+    g_tracing.store(false, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error("Unable to write trace: " + path);
+    }
+
+    // Fixed nanosecond precision, the default six significant digits would round later timestamps by several
+    // microseconds and break the nesting of short zones
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    size_t written = 0;
+    for (size_t thread_index = 0; thread_index < g_threads.size(); thread_index++) {
+        const ThreadSamples& thread = *g_threads[thread_index];
+        file << (thread_index == 0 ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+             << thread_index << ",\"args\":{\"name\":\"Thread " << thread_index << "\"}}";
+        const size_t count = std::min(thread.trace_count.load(std::memory_order_acquire), thread.trace_events.size());
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent& event = thread.trace_events[i];
+            // Timestamps are in microseconds
+            file << ",\n{\"name\":\"" << g_zone_names[event.zone] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                 << thread_index << ",\"ts\":" << static_cast<double>(event.start_ns) / 1e3
+                 << ",\"dur\":" << static_cast<double>(event.duration_ns) / 1e3 << "}";
+        }
+        written += count;
+    }
+    file << "\n]}\n";
+    if (!file) {
+        throw std::runtime_error("Unable to write trace: " + path);
+    }
+    return written;
+}
+
+bool profile_trace_active()
+{
+    return g_tracing.load(std::memory_order_relaxed);
+}
+
+void profile_collect(std::vector<ProfileZoneStats>& stats)
+{
+    static std::vector<int64_t> zone_samples;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    stats.clear();
+    for (int zone = 0; zone < g_zone_count; zone++) {
+        zone_samples.clear();
+        for (const std::unique_ptr<ThreadSamples>& thread : g_threads) {
+            const uint32_t count = thread->counts[zone].load(std::memory_order_acquire);
+            const uint32_t kept = std::min<uint32_t>(count, c_ring_size);
+            for (uint32_t i = 0; i < kept; i++) {
+                zone_samples.push_back(thread->samples[zone][i].load(std::memory_order_relaxed));
+            }
+        }
+        if (zone_samples.empty()) {
+            continue;
+        }
+
+        int64_t min = zone_samples[0];
+        int64_t sum = 0;
+        for (int64_t sample : zone_samples) {
+            min = std::min(min, sample);
+            sum += sample;
+        }
+        const size_t p99_index = (zone_samples.size() - 1) * 99 / 100;
+        std::nth_element(zone_samples.begin(), zone_samples.begin() + p99_index, zone_samples.end());
+
+        stats.push_back(ProfileZoneStats {
+            .name = g_zone_names[zone],
+            .samples = static_cast<int>(zone_samples.size()),
+            .min_ms = static_cast<double>(min) / 1e6,
+            .avg_ms = static_cast<double>(sum) / static_cast<double>(zone_samples.size()) / 1e6,
+            .p99_ms = static_cast<double>(zone_samples[p99_index]) / 1e6,
+        });
+    }
+}
+
+ProfileScope::ProfileScope(int zone)
+{
+    m_zone = zone;
+    m_start = std::chrono::steady_clock::now();
+}
+
+ProfileScope::~ProfileScope()
+{
+    const std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - m_start;
+    profile_record(m_zone, duration);
+    if (g_tracing.load(std::memory_order_relaxed)) {
+        trace_record(m_zone, m_start, duration);
+    }
+}
+
+}
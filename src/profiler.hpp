@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace util {
+
+/**
+ * @brief Timing statistics of a profiler zone over the samples kept in the ring buffers of all threads
+ */
+struct ProfileZoneStats {
+    const char* name;
+    int samples;
+    double min_ms;
+    double avg_ms;
+    double p99_ms;
+};
+
+/**
+ * @brief Get id of a named timing zone, registering it on first use
+ * @param name - Zone name, must stay valid for the lifetime of the program
+ * @return - Returns zone id, zones with the same name share an id
+ * @throws std::runtime_error if too many zones are registered
+ */
+int profile_zone(const char* name);
+
+/**
+ * @brief Record a timing sample into the ring buffer of the calling thread
+ * @param zone - Zone id
+ * @param duration - Duration of sample
+ */
+void profile_record(int zone, std::chrono::nanoseconds duration);
+
+/**
+ * @brief Collect statistics of all zones that have samples, not safe to call from several threads at once
+ * @param stats - Output list of zone statistics, reused between calls
+ */
+void profile_collect(std::vector<ProfileZoneStats>& stats);
+
+/**
+ * @brief Start recording every zone sample as a trace event, replacing any previous trace
+ *
+ * Event buffers are allocated here for all threads that recorded samples so far, so recording does not allocate.
+ * Events past the capacity of a thread are dropped. Call while no other thread is recording samples.
+ * @param events_per_thread - Capacity of the event buffer of each thread
+ */
+void profile_trace_start(size_t events_per_thread);
+
+/**
+ * @brief Stop recording trace events and write them as Chrome trace event JSON
+ *
+ * Call while no other thread is recording samples. The file can be opened in chrome://tracing or Perfetto.
+ * @param path - Path of trace file
+ * @return - Returns number of events written
+ * @throws std::runtime_error if the file cannot be written
+ */
+size_t profile_trace_stop(const std::string& path);
+
+/**
+ * @brief Check if trace events are being recorded
+ * @return - Returns true if recording
+ */
+[[nodiscard]] bool profile_trace_active();
+
+/**
+ * @brief Records the time from its construction to its destruction as a sample of a zone
+ */
+class ProfileScope {
+
+public:
+    /**
+     * @brief Construct ProfileScope and start timing
+     * @param zone - Zone id
+     */
+    explicit ProfileScope(int zone);
+
+    ProfileScope(const ProfileScope&) = delete;
+
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope();
+
+private:
+    int m_zone;
+    std::chrono::time_point<std::chrono::steady_clock> m_start;
+};
+
+}
+
+#if defined(RPS_PROFILE)
+#define RPS_PROFILE_CONCAT_INNER(a, b) a##b
+#define RPS_PROFILE_CONCAT(a, b) RPS_PROFILE_CONCAT_INNER(a, b)
+// Time the rest of the enclosing scope as a sample of the named zone
+#define RPS_PROFILE_ZONE(name)                                                                                         \
+    static const int RPS_PROFILE_CONCAT(rps_profile_zone_, __LINE__) = util::profile_zone(name);                       \
+    const util::ProfileScope RPS_PROFILE_CONCAT(rps_profile_scope_, __LINE__)(                                         \
+        RPS_PROFILE_CONCAT(rps_profile_zone_, __LINE__))
+#else
+#define RPS_PROFILE_ZONE(name)
+#endif
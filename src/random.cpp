@@ -0,0 +1,77 @@
+#include "random.hpp"
+
+namespace util {
+
+static uint64_t splitmix64(uint64_t& state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static uint32_t xorshift32(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// 24 random bits map exactly onto the float mantissa
+static const float c_unit_scale = 1.0f / 16777216.0f;
+
+Random::Random()
+{
+    seed(0);
+}
+
+Random::Random(uint64_t seed)
+{
+    this->seed(seed);
+}
+
+void Random::seed(uint64_t seed)
+{
+    for (uint32_t& lane : m_state) {
+        // xorshift state must never be zero
+        lane = static_cast<uint32_t>(splitmix64(seed) >> 32) | 1;
+    }
+    m_lane = 0;
+}
+
+uint32_t Random::next()
+{
+    m_state[m_lane] = xorshift32(m_state[m_lane]);
+    uint32_t value = m_state[m_lane];
+    m_lane = (m_lane + 1) % c_lanes;
+    return value;
+}
+
+int Random::range(int min, int max)
+{
+    uint32_t span = static_cast<uint32_t>(max - min) + 1;
+    return min + static_cast<int>(next() % span);
+}
+
+float Random::uniform(float min, float max)
+{
+    return min + static_cast<float>(next() >> 8) * c_unit_scale * (max - min);
+}
+
+void Random::fill_uniform(float* out, size_t count, float min, float max)
+{
+    const float scale = c_unit_scale * (max - min);
+    size_t i = 0;
+    for (; i + c_lanes <= count; i += c_lanes) {
+        for (int lane = 0; lane < c_lanes; lane++) {
+            m_state[lane] = xorshift32(m_state[lane]);
+            out[i + lane] = min + static_cast<float>(m_state[lane] >> 8) * scale;
+        }
+    }
+    for (; i < count; i++) {
+        out[i] = uniform(min, max);
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief Fast pseudo-random number generator made of independent xorshift lanes so bulk generation vectorizes
+ */
+class Random {
+
+public:
+    static const int c_lanes = 8;
+
+    /**
+     * @brief Constructs Random with a seed of 0
+     */
+    Random();
+
+    /**
+     * @brief Construct Random
+     * @param seed - Initial seed
+     */
+    explicit Random(uint64_t seed);
+
+    /**
+     * @brief Reseed all lanes
+     * @param seed - New seed
+     */
+    void seed(uint64_t seed);
+
+    /**
+     * @brief Get next random value
+     * @return - Returns uniformly distributed 32-bit value
+     */
+    uint32_t next();
+
+    /**
+     * @brief Get random integer in range
+     * @param min - Minimum value (inclusive)
+     * @param max - Maximum value (inclusive)
+     * @return - Returns random integer between min and max
+     */
+    int range(int min, int max);
+
+    /**
+     * @brief Get random float in range
+     * @param min - Minimum value (inclusive)
+     * @param max - Maximum value (exclusive)
+     * @return - Returns random float between min and max
+     */
+    float uniform(float min, float max);
+
+    /**
+     * @brief Fill array with random floats in range, generating all lanes at once
+     * @param out - Array to fill
+     * @param count - Number of values
+     * @param min - Minimum value (inclusive)
+     * @param max - Maximum value (exclusive)
+     */
+    void fill_uniform(float* out, size_t count, float min, float max);
+
+private:
+    std::array<uint32_t, c_lanes> m_state;
+    int m_lane;
+};
+
+}
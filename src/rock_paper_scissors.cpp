@@ -1,7 +1,12 @@
 #include "rock_paper_scissors.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <ctime>
 #include <filesystem>
 #include <optional>
+#include <thread>
 
 #define RAYGUI_IMPLEMENTATION
 #include <raygui.h>
@@ -9,28 +14,14 @@
 #include <emscripten.h>
 #endif
 
+#include "alloc_tracker.hpp"
 #include "fixed_loop.hpp"
+#include "frame_recorder.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
 
 namespace rps {
 
-/**
- * @brief Types of pieces
- */
-enum class PieceType {
-    e_rock,
-    e_paper,
-    e_scissors,
-};
-
-/**
- * @brief Piece state
- */
-struct Piece {
-    PieceType type;
-    raylib::Vector2 prev_pos;
-    raylib::Vector2 pos;
-};
-
 /**
  * @brief Contains all simulation resources
  */
@@ -48,6 +39,85 @@ struct Resources {
     raylib::Texture2D scissors_texture;
 };
 
+/**
+ * @brief Level of detail used for drawing pieces
+ */
+enum class DrawDetail {
+    e_textures,
+    e_points,
+    e_heatmap,
+};
+
+/**
+ * @brief Reusable buffers for drawing a per-pixel density heatmap of pieces
+ */
+struct Heatmap {
+    int width;
+    int height;
+    // Piece count per pixel for each of the three piece types
+    std::vector<uint32_t> counts;
+    std::vector<raylib::Color> pixels;
+    raylib::Texture2D texture;
+};
+
+/**
+ * @brief Indices of pieces in view, grouped by piece type so each type is drawn in one run
+ */
+using VisiblePieces = std::array<std::vector<int>, 3>;
+
+/**
+ * @brief Values shown in the HUD, the cached HUD is drawn again when any of them change
+ */
+struct HudValues {
+    int screen_width;
+    bool is_paused;
+    int simulation_rate;
+    int piece_count;
+    int piece_size;
+    float volume;
+
+    // Statistics are sampled periodically so they do not force a redraw every frame
+    int fps;
+    // Target cache hit rate of last tick, -1 if no targets were looked up
+    int target_hit_percent;
+    std::array<int, 3> type_counts;
+    int piece_draw_calls;
+
+    bool operator==(const HudValues&) const = default;
+};
+
+/**
+ * @brief View the cached scene was drawn with, the scene is drawn again when it changes
+ */
+struct SceneKey {
+    float camera_x;
+    float camera_y;
+    float camera_offset_x;
+    float camera_offset_y;
+    float camera_zoom;
+    int screen_width;
+    int screen_height;
+    int piece_size;
+    uint64_t tick;
+
+    bool operator==(const SceneKey&) const = default;
+};
+
+/**
+ * @brief Last drawn HUD and paused scene kept in render textures, presented again while they are current
+ */
+struct FrameCache {
+    raylib::RenderTexture2D hud;
+    HudValues hud_values;
+    bool is_hud_valid;
+    // Mouse was over the HUD when it was last drawn, so the texture may show hover highlights
+    bool was_hud_hovered;
+
+    raylib::RenderTexture2D scene;
+    SceneKey scene_key;
+    bool is_scene_valid;
+};
+
 /**
  * @brief UI states
  */
@@ -73,14 +143,32 @@ struct GameState {
     int screen_width;
     int screen_height;
 
+    raylib::Camera2D camera;
+
     bool is_paused;
     bool hud_shown;
     float volume;
+    // Frames wait for input events instead of polling while idle
+    bool is_waiting_for_events;
 
     UIStates ui_states;
 
-    std::vector<Piece> pieces;
+    Simulation sim;
     Resources resources;
+    Heatmap heatmap;
+    util::ThreadPool thread_pool;
+
+    // Spatial index of the simulation is rebuilt before drawing when pieces changed outside a tick
+    bool is_grid_dirty;
+    // Indices of pieces in view grouped by type, reused every frame
+    VisiblePieces visible_pieces;
+    // Estimated number of draw calls used for pieces in the last frame
+    int piece_draw_calls;
+
+    // Values to show in the HUD and time its statistics were last sampled
+    HudValues hud_values;
+    double hud_stats_time;
+    FrameCache frame_cache;
 
     // Selected piece by mouse
     std::optional<int> selected_piece_index;
@@ -92,172 +180,16 @@ struct GameState {
     raylib::Window window;
     raylib::AudioDevice audio_device;
     util::FixedLoop fixed_loop;
-};
-
-/**
- * @brief Initialize pieces list
- * @param count - Number of pieces
- * @param screen_width
- * @param screen_height
- * @return - Returns list of pieces
- */
-static std::vector<Piece> init_pieces(int count, int screen_width, int screen_height)
-{
-    std::vector<Piece> pieces;
-    pieces.reserve(count);
 
-    for (int i = 0; i < count; i++) {
+    util::FrameRecorder frame_recorder;
 
-        raylib::Vector2 random_pos(
-            static_cast<float>(GetRandomValue(0, screen_width)), static_cast<float>(GetRandomValue(0, screen_height)));
-
-        Piece p {
-            .type = static_cast<PieceType>(i % 3),
-            .prev_pos = random_pos,
-            .pos = random_pos,
-        };
-        pieces.push_back(p);
-    }
-
-    return pieces;
-}
-
-/**
- * @brief Gets closest piece from a number of random samples
- * @param pieces - Pieces list
- * @param piece_index - Piece to search from
- * @param samples - Number of samples to search
- * @return - Returns index of estimated random piece or null if one could not be found
- */
-static std::optional<int> estimate_closest_diff_piece(std::vector<Piece>& pieces, int piece_index, int samples)
-{
-    float min_dist = std::numeric_limits<float>::max();
-    std::optional<int> min_piece_index;
-    int sample_count = 0;
-    for (int i = 0; i < pieces.size(); i++) {
-        // Get random piece
-        int rand_index = GetRandomValue(0, static_cast<int>(pieces.size()) - 1);
-        Piece& rand_piece = pieces.at(rand_index);
-
-        // If same type, skip
-        if (rand_piece.type == pieces.at(piece_index).type) {
-            continue;
-        }
-        sample_count++;
-        float dist = pieces.at(piece_index).prev_pos.DistanceSqr(rand_piece.prev_pos);
-        if (dist < min_dist) {
-            min_dist = dist;
-            min_piece_index = rand_index;
-        }
-        if (sample_count >= samples) {
-            break;
-        }
-    }
-
-    return min_piece_index;
-}
-
-/**
- * @brief Determine if pieces are attracted
- * @param p1 - Piece 1
- * @param p2 - Piece 2
- * @return - Returns a bool optional, true if attracted, false if repelled, null if no interaction
- */
-static std::optional<bool> are_pieces_attracted(const Piece& p1, const Piece& p2)
-{
-    switch (p1.type) {
-    case PieceType::e_rock:
-        switch (p2.type) {
-        case PieceType::e_rock:
-            return {};
-        case PieceType::e_paper:
-            return false;
-        case PieceType::e_scissors:
-            return true;
-        }
-    case PieceType::e_paper:
-        switch (p2.type) {
-        case PieceType::e_rock:
-            return true;
-        case PieceType::e_paper:
-            return {};
-        case PieceType::e_scissors:
-            return false;
-        }
-    case PieceType::e_scissors:
-        switch (p2.type) {
-        case PieceType::e_rock:
-            return false;
-        case PieceType::e_paper:
-            return true;
-        case PieceType::e_scissors:
-            return {};
-        }
-    }
-    return {};
-}
-
-/**
- * @brief Calculate new pieces positions
- * @param pieces
- * @param screen_width
- * @param screen_height
- * @param piece_size
- */
-static void update_pieces_pos(
-    std::vector<Piece>& pieces,
-    int screen_width,
-    int screen_height,
-    int piece_size,
-    int close_samples,
-    bool is_hud_shown)
-{
-    // Update previous positions before updating them
-    for (Piece& p : pieces) {
-        p.prev_pos = p.pos;
-    }
-
-    for (int i = 0; i < pieces.size(); i++) {
-        // Get the closest different piece from a number of samples
-        std::optional<int> min_piece_index = estimate_closest_diff_piece(pieces, i, close_samples);
-
-        // If a close piece cannot be found
-        if (!min_piece_index.has_value()) {
-            continue;
-        }
-
-        Piece& p1 = pieces.at(i);
-        Piece& p2 = pieces.at(min_piece_index.value());
-
-        // Calculate interaction
-        std::optional<bool> is_attracted = are_pieces_attracted(p1, p2);
-
-        // If pieces are the same, skip
-        if (!is_attracted.has_value()) {
-            continue;
-        }
-
-        const float repel_speed = 1;
-        const float attract_speed = 2;
-
-        if (is_attracted.value()) {
-            raylib::Vector2 vel = (p2.prev_pos - p1.prev_pos).Normalize() * attract_speed;
-            p1.pos += vel;
-        }
-        else {
-            raylib::Vector2 vel = ((p2.prev_pos - p1.prev_pos).Normalize() * repel_speed).Negate();
-            p1.pos += vel;
-        }
-
-        // Clamp positions so they cannot leave the screen
-        p1.pos.x = std::clamp(p1.pos.x, 0.0f, static_cast<float>(screen_width) - static_cast<float>(piece_size));
-        float hud_offset = 30.0f;
-        if (!is_hud_shown) {
-            hud_offset = 0.0f;
-        }
-        p1.pos.y = std::clamp(p1.pos.y, hud_offset, static_cast<float>(screen_height) - static_cast<float>(piece_size));
-    }
-}
+#if defined(RPS_PROFILE)
+    bool profiler_shown;
+    std::vector<util::ProfileZoneStats> profile_stats;
+    // Time the current trace started
+    double trace_start_time;
+#endif
+};
 
 /**
  * @brief Play pieces sounds
@@ -280,106 +212,35 @@ static void play_piece_sound(Resources& res, PieceType type)
 }
 
 /**
- * @brief Update pieces if they collide
- * @param p1 - Piece 1
- * @param p2 - Piece 2
- * @param piece_size - Size of piece
- * @param res - Resources for playing sounds
- */
-static void update_piece_types(Piece& p1, Piece& p2, int piece_size, Resources& res)
-{
-    // Quick exit if pieces are far apart
-    if (p1.pos.DistanceSqr(p2.pos) > (powf(static_cast<float>(piece_size), 2) * 2)) {
-        return;
-    }
-
-    const float inner_padding = static_cast<float>(piece_size) * 0.15f;
-    const raylib::Vector2 piece_size_vec(
-        static_cast<float>(piece_size) - inner_padding, static_cast<float>(piece_size) - inner_padding);
-
-    const raylib::Rectangle p1_rect(p1.pos, piece_size_vec);
-    const raylib::Rectangle p2_rect(p2.pos, piece_size_vec);
-
-    if (!p1_rect.CheckCollision(p2_rect)) {
-        return;
-    }
-
-    switch (p1.type) {
-    case PieceType::e_rock:
-        switch (p2.type) {
-        case PieceType::e_rock:
-            return;
-        case PieceType::e_paper:
-            p1.type = PieceType::e_paper;
-            play_piece_sound(res, PieceType::e_paper);
-            return;
-        case PieceType::e_scissors:
-            p2.type = PieceType::e_rock;
-            play_piece_sound(res, PieceType::e_rock);
-            return;
-        }
-    case PieceType::e_paper:
-        switch (p2.type) {
-        case PieceType::e_rock:
-            p2.type = PieceType::e_paper;
-            play_piece_sound(res, PieceType::e_paper);
-            return;
-        case PieceType::e_paper:
-            return;
-        case PieceType::e_scissors:
-            p1.type = PieceType::e_scissors;
-            play_piece_sound(res, PieceType::e_scissors);
-            return;
-        }
-    case PieceType::e_scissors:
-        switch (p2.type) {
-        case PieceType::e_rock:
-            p1.type = PieceType::e_rock;
-            play_piece_sound(res, PieceType::e_rock);
-            return;
-        case PieceType::e_paper:
-            p2.type = PieceType::e_scissors;
-            play_piece_sound(res, PieceType::e_scissors);
-            return;
-        case PieceType::e_scissors:
-            return;
-        }
-    }
-}
-
-/**
- * @brief Loop through all pairs from vector and call function
- * @tparam T - Vector type
- * @param vec - Vector
- * @param func - Function
+ * @brief Play the sound of each piece type that pieces converted to during the last tick
+ * @param res - Resources struct
+ * @param conversions - Number of conversions to each type
  */
-template <typename T>
-static void for_all_pairs(std::vector<T>& vec, std::function<void(T&, T&)> func)
+static void play_conversion_sounds(Resources& res, const std::array<int, 3>& conversions)
 {
-    for (int i = 0; i < vec.size() - 1; i++) {
-        for (int j = i + 1; j < vec.size(); j++) {
-            std::invoke(func, vec.at(i), vec.at(j));
+    RPS_PROFILE_ZONE("Audio");
+    for (int type = 0; type < 3; type++) {
+        if (conversions[type] > 0) {
+            play_piece_sound(res, static_cast<PieceType>(type));
         }
     }
 }
 
 /**
  * @brief Get index of selected piece from mouse position
- * @param pieces
+ * @param sim - Simulation with the current piece positions
  * @param piece_size
  * @param mouse_pos
  * @return - Returns optional with either the index of piece of null if no piece is selected
  */
-static std::optional<int> get_piece_from_click(std::vector<Piece>& pieces, int piece_size, raylib::Vector2 mouse_pos)
+static std::optional<int> get_piece_from_click(const Simulation& sim, int piece_size, raylib::Vector2 mouse_pos)
 {
     raylib::Vector2 size(static_cast<float>(piece_size), static_cast<float>(piece_size));
-    int i = 0;
-    for (Piece& p : pieces) {
-        raylib::Rectangle rect(p.pos, size);
+    for (int i = 0; i < static_cast<int>(sim.pieces.size()); i++) {
+        raylib::Rectangle rect(position(sim, i), size);
         if (rect.CheckCollision(mouse_pos)) {
             return i;
         }
-        i++;
     }
     return {};
 }
@@ -438,73 +299,416 @@ static Resources init_resources(int piece_size)
 }
 
 /**
- * @brief Update pieces list with new count
- * @param pieces - Original pieces list
- * @param new_count - New number of pieces
+ * @brief Write current piece state directly into the next frame of the recording
+ * @param recorder - Open frame recorder
+ * @param sim - Simulation to record
+ */
+static void record_frame(util::FrameRecorder& recorder, const Simulation& sim)
+{
+    util::FrameColumns columns = recorder.append_frame(sim.tick, static_cast<uint32_t>(sim.pieces.size()));
+    for (int i = 0; i < static_cast<int>(sim.pieces.size()); i++) {
+        const raylib::Vector2 pos = position(sim, i);
+        columns.types[i] = static_cast<uint8_t>(sim.pieces[i].type);
+        columns.pos_x[i] = pos.x;
+        columns.pos_y[i] = pos.y;
+    }
+}
+
+/**
+ * @brief Stop recording frames, logging an error finishing the file instead of throwing
+ * @param recorder - Open frame recorder
+ */
+static void stop_recording(util::FrameRecorder& recorder)
+{
+    try {
+        recorder.close();
+        TraceLog(LOG_INFO, "Stopped recording frames");
+    }
+    catch (std::exception& e) {
+        TraceLog(LOG_WARNING, "%s", e.what());
+    }
+}
+
+/**
+ * @brief Get texture of piece type
+ * @param res - Resources with piece textures
+ * @param type - Type of piece
+ * @return - Returns texture sized to the current piece size
+ */
+static raylib::Texture2D& piece_texture(Resources& res, PieceType type)
+{
+    switch (type) {
+    case PieceType::e_rock:
+        return res.rock_texture;
+    case PieceType::e_paper:
+        return res.paper_texture;
+    case PieceType::e_scissors:
+        return res.scissors_texture;
+    }
+    return res.rock_texture;
+}
+
+/**
+ * @brief Draw pieces one type at a time, so rlgl only starts a new batch when the texture changes between types
+ * @param sim - Simulation the pieces are in
+ * @param visible - Indices of pieces to draw grouped by type
+ * @param res - Resources for piece textures
+ * @param blend - Blend fraction for position interpolation
+ */
+static void draw_pieces(const Simulation& sim, const VisiblePieces& visible, Resources& res, float blend)
+{
+    RPS_PROFILE_ZONE("Draw pieces");
+    for (int type = 0; type < 3; type++) {
+        raylib::Texture2D& texture = piece_texture(res, static_cast<PieceType>(type));
+        for (int i : visible[type]) {
+            texture.Draw(interpolate_pos(sim, i, blend));
+        }
+    }
+}
+
+/**
+ * @brief Choose how pieces are drawn so draw cost stays bounded at high counts and small sizes
+ * @param piece_count - Number of pieces in view
+ * @param piece_screen_size - Size of piece on screen in pixels
  * @param screen_width
  * @param screen_height
- * @return - Returns new list of pieces
+ * @return - Returns level of detail to draw pieces with
  */
-static std::vector<Piece> update_piece_count(
-    std::vector<Piece>& pieces, int new_count, int screen_width, int screen_height)
+static DrawDetail select_draw_detail(int piece_count, float piece_screen_size, int screen_width, int screen_height)
 {
-    std::vector<Piece> new_pieces;
-    new_pieces.reserve(new_count);
+    // Textures are unreadable at or below this size
+    const float point_size = 4.0f;
+    // Average number of pieces covering each screen pixel at which individual pieces are no longer visible
+    const float heatmap_coverage = 2.0f;
 
-    if (pieces.size() < new_count) {
-        for (Piece& piece : pieces) {
-            new_pieces.push_back(piece);
-        }
-        std::vector<Piece> extras
-            = init_pieces(static_cast<int>(new_count - pieces.size()), screen_width, screen_height);
-        for (Piece& p : extras) {
-            new_pieces.push_back(p);
-        }
-        return new_pieces;
+    if (piece_screen_size > point_size) {
+        return DrawDetail::e_textures;
     }
-    else {
-        for (int i = 0; i < new_count; i++) {
-            new_pieces.push_back(pieces.at(i));
+    const float coverage = static_cast<float>(piece_count) * piece_screen_size * piece_screen_size
+        / static_cast<float>(screen_width * screen_height);
+    if (coverage >= heatmap_coverage) {
+        return DrawDetail::e_heatmap;
+    }
+    return DrawDetail::e_points;
+}
+
+/**
+ * @brief Get flat color representing piece type
+ * @param type - Type of piece
+ * @return - Returns color of type
+ */
+static raylib::Color piece_color(PieceType type)
+{
+    switch (type) {
+    case PieceType::e_rock:
+        return raylib::Color::Gray();
+    case PieceType::e_paper:
+        return raylib::Color::Blue();
+    case PieceType::e_scissors:
+        return raylib::Color::Red();
+    }
+    return raylib::Color::Black();
+}
+
+/**
+ * @brief Get display name of piece type
+ * @param type - Type of piece
+ * @return - Returns name of type
+ */
+static const char* piece_name(PieceType type)
+{
+    switch (type) {
+    case PieceType::e_rock:
+        return "Rock";
+    case PieceType::e_paper:
+        return "Paper";
+    case PieceType::e_scissors:
+        return "Scissors";
+    }
+    return "";
+}
+
+/**
+ * @brief Draw pieces as type colored squares without textures
+ * @param sim - Simulation the pieces are in
+ * @param visible - Indices of pieces to draw grouped by type
+ * @param piece_size - Size of piece
+ * @param blend - Blend fraction for position interpolation
+ */
+static void draw_piece_points(const Simulation& sim, const VisiblePieces& visible, int piece_size, float blend)
+{
+    const raylib::Vector2 size(static_cast<float>(piece_size), static_cast<float>(piece_size));
+    for (int type = 0; type < 3; type++) {
+        const raylib::Color color = piece_color(static_cast<PieceType>(type));
+        for (int i : visible[type]) {
+            DrawRectangleV(interpolate_pos(sim, i, blend), size, color);
         }
-        return new_pieces;
     }
 }
 
 /**
- * @brief Draw pieces
- * @param pieces - Pieces list
- * @param res - Resources for piece textures
+ * @brief Estimate number of draw calls rlgl issues for pieces
+ *
+ * rlgl starts a new draw call when the texture changes and flushes its batch when the vertex buffer is full.
+ * Textured pieces use one texture per type, points and the heatmap share a single texture.
+ * @param detail - Level of detail pieces are drawn with
+ * @param visible - Indices of pieces in view grouped by type
+ * @return - Returns estimated draw calls
+ */
+static int estimate_piece_draw_calls(DrawDetail detail, const VisiblePieces& visible)
+{
+    // Quads per rlgl batch buffer, smaller for OpenGL ES 2 on the web
+#if defined(PLATFORM_WEB)
+    const int batch_quads = 2048;
+#else
+    const int batch_quads = 8192;
+#endif
+    int total = 0;
+    int draw_calls = 0;
+    for (const std::vector<int>& indices : visible) {
+        const int count = static_cast<int>(indices.size());
+        total += count;
+        draw_calls += (count + batch_quads - 1) / batch_quads;
+    }
+    switch (detail) {
+    case DrawDetail::e_textures:
+        return draw_calls;
+    case DrawDetail::e_points:
+        return (total + batch_quads - 1) / batch_quads;
+    case DrawDetail::e_heatmap:
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Resize heatmap buffers and texture if screen size changed
+ * @param heatmap - Heatmap to resize
+ * @param width - Screen width
+ * @param height - Screen height
+ */
+static void update_heatmap_size(Heatmap& heatmap, int width, int height)
+{
+    if (heatmap.width == width && heatmap.height == height) {
+        return;
+    }
+    heatmap.width = width;
+    heatmap.height = height;
+    heatmap.counts.resize(static_cast<size_t>(width) * height * 3);
+    heatmap.pixels.resize(static_cast<size_t>(width) * height);
+    heatmap.texture = raylib::Texture2D(raylib::Image(width, height, raylib::Color::Blank()));
+}
+
+/**
+ * @brief Draw pieces as a per-pixel density heatmap computed in parallel and uploaded as one texture
+ * @param sim - Simulation the pieces are in
+ * @param visible - Indices of pieces to draw grouped by type
+ * @param heatmap - Heatmap buffers sized to the screen
+ * @param thread_pool - Threads to compute heatmap on
+ * @param camera - Camera mapping world to screen
+ * @param piece_size - Size of piece
  * @param blend - Blend fraction for position interpolation
  */
-static void draw_pieces(std::vector<Piece>& pieces, Resources& res, float blend)
-{
-    for (Piece& p : pieces) {
-        switch (p.type) {
-        case PieceType::e_rock:
-            res.rock_texture.Draw(p.prev_pos.Lerp(p.pos, blend));
-            break;
-        case PieceType::e_paper:
-            res.paper_texture.Draw(p.prev_pos.Lerp(p.pos, blend));
-            break;
-        case PieceType::e_scissors:
-            res.scissors_texture.Draw(p.prev_pos.Lerp(p.pos, blend));
-            break;
+static void draw_piece_heatmap(
+    const Simulation& sim,
+    const VisiblePieces& visible,
+    Heatmap& heatmap,
+    util::ThreadPool& thread_pool,
+    const raylib::Camera2D& camera,
+    int piece_size,
+    float blend)
+{
+    const int width = heatmap.width;
+    const int height = heatmap.height;
+    const float half_size = static_cast<float>(piece_size) / 2.0f;
+
+    thread_pool.parallel_for(height, 16, [&](int begin, int end) {
+        std::fill(
+            heatmap.counts.begin() + static_cast<ptrdiff_t>(begin) * width * 3,
+            heatmap.counts.begin() + static_cast<ptrdiff_t>(end) * width * 3,
+            0);
+    });
+
+    // Pieces from different threads can land on the same pixel
+    for (int type = 0; type < 3; type++) {
+        const std::vector<int>& indices = visible[type];
+        thread_pool.parallel_for(static_cast<int>(indices.size()), 4096, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const raylib::Vector2 center
+                    = interpolate_pos(sim, indices[i], blend) + raylib::Vector2(half_size, half_size);
+                const int x = static_cast<int>((center.x - camera.target.x) * camera.zoom + camera.offset.x);
+                const int y = static_cast<int>((center.y - camera.target.y) * camera.zoom + camera.offset.y);
+                if (x < 0 || y < 0 || x >= width || y >= height) {
+                    continue;
+                }
+                size_t index = (static_cast<size_t>(y) * width + x) * 3 + type;
+                std::atomic_ref<uint32_t>(heatmap.counts[index]).fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    const raylib::Color rock = piece_color(PieceType::e_rock);
+    const raylib::Color paper = piece_color(PieceType::e_paper);
+    const raylib::Color scissors = piece_color(PieceType::e_scissors);
+    thread_pool.parallel_for(height, 16, [&](int begin, int end) {
+        for (size_t i = static_cast<size_t>(begin) * width; i < static_cast<size_t>(end) * width; i++) {
+            const uint32_t r = heatmap.counts[i * 3];
+            const uint32_t p = heatmap.counts[i * 3 + 1];
+            const uint32_t s = heatmap.counts[i * 3 + 2];
+            const uint32_t total = r + p + s;
+            if (total == 0) {
+                heatmap.pixels[i] = raylib::Color::Blank();
+                continue;
+            }
+            // Mix type colors by share, denser pixels are more opaque
+            heatmap.pixels[i] = raylib::Color(
+                static_cast<unsigned char>((rock.r * r + paper.r * p + scissors.r * s) / total),
+                static_cast<unsigned char>((rock.g * r + paper.g * p + scissors.g * s) / total),
+                static_cast<unsigned char>((rock.b * r + paper.b * p + scissors.b * s) / total),
+                static_cast<unsigned char>(std::min<uint32_t>(255, 95 + total * 32)));
+        }
+    });
+
+    heatmap.texture.Update(heatmap.pixels.data());
+    heatmap.texture.Draw(0, 0);
+}
+
+/**
+ * @brief Collect pieces that may be visible through the camera from the spatial index
+ * @param sim - Simulation with a spatial index over current piece positions
+ * @param camera - Camera to cull against
+ * @param screen_width
+ * @param screen_height
+ * @param piece_size - Size of piece
+ * @param visible - Output lists of piece indices grouped by type, reused between calls
+ */
+static void cull_pieces(
+    const Simulation& sim,
+    const raylib::Camera2D& camera,
+    int screen_width,
+    int screen_height,
+    int piece_size,
+    VisiblePieces& visible)
+{
+    RPS_PROFILE_ZONE("Cull");
+    const raylib::Vector2 top_left = camera.GetScreenToWorld(raylib::Vector2(0, 0));
+    const raylib::Vector2 bottom_right = camera.GetScreenToWorld(
+        raylib::Vector2(static_cast<float>(screen_width), static_cast<float>(screen_height)));
+
+    // Pieces extend right and down from their position, and are drawn between their previous and current positions
+    const float margin = static_cast<float>(piece_size) + 4.0f;
+    const float left = top_left.x - margin;
+    const float top = top_left.y - margin;
+    const float right = bottom_right.x + margin;
+    const float bottom = bottom_right.y + margin;
+
+    for (std::vector<int>& indices : visible) {
+        indices.clear();
+    }
+    sim.grid.for_each_in_rect(left, top, right - left, bottom - top, [&](int i) {
+        const raylib::Vector2 pos = position(sim, i);
+        if (pos.x >= left && pos.x <= right && pos.y >= top && pos.y <= bottom) {
+            visible[static_cast<int>(sim.pieces[i].type)].push_back(i);
         }
+    });
+}
+
+/**
+ * @brief Estimate memory the game needs for a number of pieces, the simulation and the lists of pieces in view
+ * @param piece_count - Number of pieces
+ * @param worker_capacity - Piece capacity of the domain worker shared memory, 0 without domain workers
+ * @return - Returns estimated size in bytes
+ */
+static size_t estimate_game_memory_bytes(int piece_count, int worker_capacity)
+{
+    // With the whole world in view the lists hold every piece, with the doubling slack of growing between frames
+    const size_t visible_bytes = sizeof(int) * 2 * static_cast<size_t>(piece_count);
+    return estimate_memory_bytes(piece_count, worker_capacity) + visible_bytes;
+}
+
+/**
+ * @brief Fit camera so the whole world is in view below the HUD
+ * @param camera - Camera to update
+ * @param world_width
+ * @param world_height
+ * @param screen_width
+ * @param screen_height
+ * @param top_margin - Height of screen area covered at the top
+ */
+static void fit_camera_to_world(
+    raylib::Camera2D& camera, int world_width, int world_height, int screen_width, int screen_height, int top_margin)
+{
+    const float view_height = static_cast<float>(std::max(1, screen_height - top_margin));
+    camera.zoom = std::min(
+        static_cast<float>(screen_width) / static_cast<float>(world_width),
+        view_height / static_cast<float>(world_height));
+    camera.rotation = 0.0f;
+    camera.offset = raylib::Vector2(
+        static_cast<float>(screen_width) / 2.0f, static_cast<float>(top_margin) + view_height / 2.0f);
+    camera.target
+        = raylib::Vector2(static_cast<float>(world_width) / 2.0f, static_cast<float>(world_height) / 2.0f);
+}
+
+/**
+ * @brief Pan camera with right mouse drag and zoom around the cursor with the mouse wheel
+ * @param camera - Camera to update
+ */
+static void update_camera_input(raylib::Camera2D& camera)
+{
+    if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
+        camera.target = raylib::Vector2(camera.target) - raylib::Vector2(GetMouseDelta()) / camera.zoom;
+    }
+
+    const float wheel = GetMouseWheelMove();
+    if (wheel != 0.0f) {
+        // Keep the world point under the cursor fixed while zooming
+        const raylib::Vector2 mouse_pos = GetMousePosition();
+        camera.target = camera.GetScreenToWorld(mouse_pos);
+        camera.offset = mouse_pos;
+        camera.zoom = std::clamp(camera.zoom * (1.0f + 0.1f * wheel), 0.01f, 50.0f);
+    }
+}
+
+/**
+ * @brief Draw a slider whose position is the logarithm of an integer value
+ * @param bounds - Slider rectangle
+ * @param text - Label left of the slider
+ * @param value - Current value
+ * @param min_value - Smallest selectable value
+ * @param max_value - Largest selectable value
+ * @return - Returns selected value, the current one unless the slider moved
+ */
+static int log_slider(raylib::Rectangle bounds, const char* text, int value, int min_value, int max_value)
+{
+    const float position = std::log10(static_cast<float>(value));
+    const float new_position = GuiSlider(
+        bounds,
+        text,
+        "",
+        position,
+        std::log10(static_cast<float>(min_value)),
+        std::log10(static_cast<float>(max_value)));
+    // Converting the position back is not exact for large values, so the value only changes when the slider moved
+    if (new_position == position) {
+        return value;
     }
+    return std::clamp(static_cast<int>(std::lround(std::pow(10.0f, new_position))), min_value, max_value);
 }
 
 /**
  * @brief Draw HUD at the top of the screen
  * @param game_state
  * @param ui_states
+ * @param values - Statistics to show
  */
-static void draw_hud(GameState& game_state, UIStates& ui_states)
+static void draw_hud(GameState& game_state, UIStates& ui_states, const HudValues& values)
 {
+    RPS_PROFILE_ZONE("Draw HUD");
     // Toolbar
     DrawRectangle(0, 0, game_state.screen_width, 30, raylib::Color::LightGray());
 
     // FPS
-    raylib::DrawText(std::to_string(GetFPS()) + " FPS", 10, 6, 20, raylib::Color::DarkGreen());
+    ::DrawText(TextFormat("%i FPS", values.fps), 10, 6, 20, raylib::Color::DarkGreen());
 
     const int controls_offset = 125;
 
@@ -523,14 +727,9 @@ static void draw_hud(GameState& game_state, UIStates& ui_states)
         1,
         250));
 
-    // Count slider
-    ui_states.piece_count = static_cast<int>(GuiSlider(
-        raylib::Rectangle(controls_offset + 350, 2, 100, 25),
-        "Count",
-        "",
-        static_cast<float>(game_state.piece_count),
-        3,
-        1000));
+    // Count slider, logarithmic so a few pieces and a million are both reachable
+    ui_states.piece_count
+        = log_slider(raylib::Rectangle(controls_offset + 350, 2, 100, 25), "Count", game_state.piece_count, 3, 1000000);
 
     // Size slider
     ui_states.piece_size = static_cast<int>(GuiSlider(
@@ -544,6 +743,28 @@ static void draw_hud(GameState& game_state, UIStates& ui_states)
     // Defaults button
     ui_states.defaults_pressed = GuiButton(raylib::Rectangle(controls_offset + 620, 2, 70, 25), "Defaults");
 
+    // Target cache hit rate of last tick
+    if (values.target_hit_percent >= 0) {
+        ::DrawText(
+            TextFormat("Target hits %i%%", values.target_hit_percent),
+            controls_offset + 700,
+            3,
+            10,
+            raylib::Color::DarkGray());
+    }
+
+    // Draw calls used for pieces
+    ::DrawText(
+        TextFormat("Draw calls %i", values.piece_draw_calls), controls_offset + 790, 3, 10, raylib::Color::DarkGray());
+
+    // Piece count of each type
+    ::DrawText(
+        TextFormat("R %i  P %i  S %i", values.type_counts[0], values.type_counts[1], values.type_counts[2]),
+        controls_offset + 700,
+        17,
+        10,
+        raylib::Color::DarkGray());
+
     // Hide HUD button
     ui_states.hud_pressed
         = GuiButton(raylib::Rectangle(static_cast<float>(game_state.screen_width - 30), 2, 25, 25), "#44#");
@@ -564,6 +785,235 @@ static void draw_hud(GameState& game_state, UIStates& ui_states)
         1);
 }
 
+/**
+ * @brief Update values shown in the HUD, sampling the statistics twice per second
+ * @param game_state
+ */
+static void update_hud_values(GameState& game_state)
+{
+    HudValues& values = game_state.hud_values;
+    values.screen_width = game_state.screen_width;
+    values.is_paused = game_state.is_paused;
+    values.simulation_rate = game_state.simulation_rate;
+    values.piece_count = game_state.piece_count;
+    values.piece_size = game_state.piece_size;
+    values.volume = game_state.volume;
+
+    // Called every frame so the frame time average stays current
+    const int fps = GetFPS();
+    const double time = GetTime();
+    if (time - game_state.hud_stats_time < 0.5) {
+        return;
+    }
+    game_state.hud_stats_time = time;
+
+    values.fps = fps;
+    const TargetCacheStats& target_stats = game_state.sim.target_stats;
+    const uint64_t target_lookups = target_stats.hits + target_stats.misses;
+    values.target_hit_percent
+        = target_lookups > 0 ? static_cast<int>(target_stats.hits * 100 / target_lookups) : -1;
+    // Read from the sizes of the type index lists
+    for (int type = 0; type < 3; type++) {
+        values.type_counts[type] = static_cast<int>(game_state.sim.type_indices[type].size());
+    }
+    values.piece_draw_calls = game_state.piece_draw_calls;
+}
+
+/**
+ * @brief Recreate render texture if its size changed
+ * @param texture - Render texture to resize
+ * @param width
+ * @param height
+ */
+static void update_render_texture_size(raylib::RenderTexture2D& texture, int width, int height)
+{
+    if (texture.id != 0 && texture.texture.width == width && texture.texture.height == height) {
+        return;
+    }
+    texture = raylib::RenderTexture2D(width, height);
+}
+
+/**
+ * @brief Draw render texture at the top left of the screen
+ * @param texture - Render texture to draw
+ */
+static void draw_render_texture(const raylib::RenderTexture2D& texture)
+{
+    // Render textures are stored upside down
+    const raylib::Rectangle source(
+        0, 0, static_cast<float>(texture.texture.width), -static_cast<float>(texture.texture.height));
+    DrawTextureRec(texture.texture, source, raylib::Vector2(0, 0), raylib::Color::White());
+}
+
+/**
+ * @brief Draw HUD through its cache, drawing the controls again only when hovered or when a shown value changed
+ *
+ * Controls only react to the mouse while it is over them, so skipping them while the mouse is elsewhere only skips
+ * their drawing. The frame the mouse leaves is drawn once more, so no hover highlight stays in the cached texture.
+ * @param game_state
+ */
+static void draw_cached_hud(GameState& game_state)
+{
+    FrameCache& cache = game_state.frame_cache;
+    update_hud_values(game_state);
+    const bool is_hovered = GetMouseY() < 30;
+    if (is_hovered || cache.was_hud_hovered || !cache.is_hud_valid || !(game_state.hud_values == cache.hud_values)) {
+        update_render_texture_size(cache.hud, game_state.screen_width, 30);
+        cache.hud.BeginMode();
+        ClearBackground(raylib::Color::Blank());
+        draw_hud(game_state, game_state.ui_states, game_state.hud_values);
+        cache.hud.EndMode();
+        cache.hud_values = game_state.hud_values;
+        cache.is_hud_valid = true;
+        cache.was_hud_hovered = is_hovered;
+    }
+    else {
+        game_state.ui_states.fullscreen_pressed = false;
+        game_state.ui_states.restart_pressed = false;
+        game_state.ui_states.hud_pressed = false;
+        game_state.ui_states.defaults_pressed = false;
+    }
+    draw_render_texture(cache.hud);
+}
+
+/**
+ * @brief Draw a banner with the winner once a single type is left
+ * @param game_state
+ */
+static void draw_winner(GameState& game_state)
+{
+    const std::optional<PieceType> winner_type = winner(game_state.sim);
+    if (winner_type.has_value()) {
+        const char* winner_text = TextFormat("%s wins!", piece_name(winner_type.value()));
+        const int winner_width = MeasureText(winner_text, 20);
+        ::DrawText(
+            winner_text, (game_state.screen_width - winner_width) / 2, 40, 20, piece_color(winner_type.value()));
+    }
+}
+
+#if defined(RPS_PROFILE)
+/**
+ * @brief Draw overlay with timing statistics of every profiler zone
+ * @param game_state
+ */
+static void draw_profiler_overlay(GameState& game_state)
+{
+    util::profile_collect(game_state.profile_stats);
+
+    const int x = 10;
+    const int y = 40;
+    const int row_height = 14;
+    const int height = row_height * (static_cast<int>(game_state.profile_stats.size()) + 1) + 8;
+    DrawRectangle(x, y, 330, height, raylib::Color(0, 0, 0, 180));
+
+    const char* headers[] = { "Zone", "min ms", "avg ms", "p99 ms" };
+    const int columns[] = { x + 6, x + 130, x + 195, x + 260 };
+    for (int i = 0; i < 4; i++) {
+        ::DrawText(headers[i], columns[i], y + 4, 10, raylib::Color::LightGray());
+    }
+
+    int row_y = y + 4 + row_height;
+    for (const util::ProfileZoneStats& zone : game_state.profile_stats) {
+        ::DrawText(zone.name, columns[0], row_y, 10, raylib::Color::RayWhite());
+        ::DrawText(TextFormat("%.3f", zone.min_ms), columns[1], row_y, 10, raylib::Color::RayWhite());
+        ::DrawText(TextFormat("%.3f", zone.avg_ms), columns[2], row_y, 10, raylib::Color::RayWhite());
+        ::DrawText(TextFormat("%.3f", zone.p99_ms), columns[3], row_y, 10, raylib::Color::RayWhite());
+        row_y += row_height;
+    }
+}
+
+/**
+ * @brief Start recording profile zones as trace events, or stop and write them to the configured trace file
+ * @param game_state
+ */
+static void toggle_trace(GameState& game_state)
+{
+    // Enough for the configured duration at high frame and simulation rates, about 6 MB per thread
+    const size_t trace_events_per_thread = 1 << 18;
+    try {
+        if (util::profile_trace_active()) {
+            const size_t event_count = util::profile_trace_stop(game_state.config.trace_path);
+            TraceLog(
+                LOG_INFO,
+                "Wrote %llu trace events to %s",
+                static_cast<unsigned long long>(event_count),
+                game_state.config.trace_path.c_str());
+        }
+        else {
+            util::profile_trace_start(trace_events_per_thread);
+            game_state.trace_start_time = GetTime();
+            TraceLog(LOG_INFO, "Tracing for %.1f seconds", game_state.config.trace_seconds);
+        }
+    }
+    catch (std::exception& e) {
+        TraceLog(LOG_WARNING, "%s", e.what());
+    }
+}
+#endif
+
+/**
+ * @brief Clear the screen and draw the world and its pieces
+ * @param state
+ * @param blend - Blend fraction for position interpolation
+ */
+static void draw_scene(GameState& state, float blend)
+{
+    RPS_PROFILE_ZONE("Draw scene");
+    ClearBackground(raylib::Color::RayWhite());
+
+    const int visible_count = static_cast<int>(
+        state.visible_pieces[0].size() + state.visible_pieces[1].size() + state.visible_pieces[2].size());
+    const DrawDetail detail = select_draw_detail(
+        visible_count,
+        static_cast<float>(state.piece_size) * state.camera.zoom,
+        state.screen_width,
+        state.screen_height);
+    state.piece_draw_calls = estimate_piece_draw_calls(detail, state.visible_pieces);
+
+    if (detail == DrawDetail::e_heatmap) {
+        update_heatmap_size(state.heatmap, state.screen_width, state.screen_height);
+        draw_piece_heatmap(
+            state.sim,
+            state.visible_pieces,
+            state.heatmap,
+            state.thread_pool,
+            state.camera,
+            state.piece_size,
+            blend);
+    }
+    else {
+        state.camera.BeginMode();
+        DrawRectangleLines(0, 0, state.sim.world.width, state.sim.world.height, raylib::Color::LightGray());
+        if (detail == DrawDetail::e_textures) {
+            draw_pieces(state.sim, state.visible_pieces, state.resources, blend);
+        }
+        else {
+            draw_piece_points(state.sim, state.visible_pieces, state.piece_size, blend);
+        }
+        state.camera.EndMode();
+    }
+}
+
+/**
+ * @brief Wait for input events at the end of each frame while paused, nothing changes on screen without input then
+ * @param game_state
+ */
+static void update_frame_pacing(GameState& game_state)
+{
+#if !defined(PLATFORM_WEB)
+    if (game_state.is_paused == game_state.is_waiting_for_events) {
+        return;
+    }
+    game_state.is_waiting_for_events = game_state.is_paused;
+    if (game_state.is_waiting_for_events) {
+        EnableEventWaiting();
+    }
+    else {
+        DisableEventWaiting();
+    }
+#endif
+}
+
 #if defined(PLATFORM_WEB)
 EM_JS(int, web_canvas_width, (), { return canvas.width; });
 EM_JS(int, web_canvas_height, (), { return canvas.height; });
@@ -579,18 +1029,42 @@ EM_JS(int, web_canvas_height, (), { return canvas.height; });
  */
 static void main_loop(void* game_state_ptr)
 {
+    RPS_PROFILE_ZONE("Frame");
     GameState& state = *((GameState*)game_state_ptr);
 
+#if defined(RPS_TRACK_ALLOCATIONS)
+    const uint64_t allocations_start = util::allocation_count();
+#endif
+
 #if defined(PLATFORM_WEB)
     if (state.screen_width != web_canvas_width() || state.screen_height != web_canvas_height()) {
         state.window.SetSize(web_canvas_width(), web_canvas_height());
     }
 #endif
 
-    // Update screen size
+    // Update screen size, the world keeps its size and the view is fitted to the new window
     if (state.window.IsResized()) {
         state.screen_height = state.window.GetHeight();
         state.screen_width = state.window.GetWidth();
+        fit_camera_to_world(
+            state.camera,
+            state.sim.world.width,
+            state.sim.world.height,
+            state.screen_width,
+            state.screen_height,
+            30);
+    }
+
+    // Camera pan and zoom, fit to world with keyboard shortcut
+    update_camera_input(state.camera);
+    if (IsKeyPressed(KEY_C)) {
+        fit_camera_to_world(
+            state.camera,
+            state.sim.world.width,
+            state.sim.world.height,
+            state.screen_width,
+            state.screen_height,
+            30);
     }
 
     // Pause with keyboard shortcut
@@ -603,21 +1077,49 @@ static void main_loop(void* game_state_ptr)
         }
     }
 
-    state.fixed_loop.update(20, [&]() {
-        if (state.is_paused) {
-            return;
-        }
-        update_pieces_pos(
-            state.pieces,
-            state.screen_width,
-            state.screen_height,
-            state.piece_size,
-            state.config.piece_samples,
-            state.hud_shown);
-        for_all_pairs<Piece>(state.pieces, [&](Piece& p1, Piece& p2) {
-            update_piece_types(p1, p2, state.piece_size, state.resources);
+    {
+        RPS_PROFILE_ZONE("Fixed update");
+        state.fixed_loop.update(20, [&]() {
+            if (state.is_paused) {
+                return;
+            }
+            RPS_PROFILE_ZONE("Tick");
+            const Movement movement {
+                .model = state.config.movement_model,
+                .piece_size = state.piece_size,
+                .samples = state.config.piece_samples,
+                .max_acceleration = state.config.max_acceleration,
+                .damping = state.config.velocity_damping,
+                .target_refresh_ticks = state.config.target_refresh_ticks,
+                .target_distance_band = state.config.target_distance_band,
+            };
+            step(state.sim, movement);
+            state.is_grid_dirty = false;
+            play_conversion_sounds(state.resources, state.sim.conversions);
+            if (state.frame_recorder.is_open() && state.sim.tick % state.config.record_interval == 0) {
+                // A failed recording, such as on a full disk, stops the recording but not the game
+                try {
+                    record_frame(state.frame_recorder, state.sim);
+                }
+                catch (std::exception& e) {
+                    TraceLog(LOG_WARNING, "%s", e.what());
+                    stop_recording(state.frame_recorder);
+                }
+            }
         });
-    });
+    }
+
+#if !defined(PLATFORM_WEB)
+    // Nothing is visible while minimized, keep simulating without drawing and sleep until the next tick
+    if (state.window.IsMinimized() || state.window.IsHidden()) {
+        // Blocks until the next input event, such as the window being restored, while waiting for events
+        PollInputEvents();
+        if (!state.is_paused) {
+            std::this_thread::sleep_for(state.fixed_loop.time_to_next_step());
+        }
+        return;
+    }
+#endif
 
     // De-selecting piece with mouse
     if (IsMouseButtonUp(MOUSE_BUTTON_LEFT) && state.selected_piece_index.has_value()) {
@@ -625,9 +1127,11 @@ static void main_loop(void* game_state_ptr)
         raylib::Mouse::SetCursor(MOUSE_CURSOR_DEFAULT);
     }
 
+    const raylib::Vector2 mouse_world_pos = state.camera.GetScreenToWorld(GetMousePosition());
+
     // Select piece with mouse
     if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-        state.selected_piece_index = get_piece_from_click(state.pieces, state.piece_size, GetMousePosition());
+        state.selected_piece_index = get_piece_from_click(state.sim, state.piece_size, mouse_world_pos);
         if (state.selected_piece_index.has_value()) {
             raylib::Mouse::SetCursor(MOUSE_CURSOR_POINTING_HAND);
         }
@@ -637,33 +1141,87 @@ static void main_loop(void* game_state_ptr)
     if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && state.selected_piece_index.has_value()) {
         const raylib::Vector2 piece_middle(
             static_cast<float>(state.piece_size) / 2.0f, static_cast<float>(state.piece_size) / 2.0f);
-        state.pieces.at(state.selected_piece_index.value()).pos = raylib::Vector2(GetMousePosition()) - piece_middle;
+        set_position(state.sim, state.selected_piece_index.value(), mouse_world_pos - piece_middle);
+        state.is_grid_dirty = true;
     }
 
+    // While paused, pieces are not drawn again as long as nothing in view changed
+    FrameCache& cache = state.frame_cache;
+    const SceneKey scene_key {
+        .camera_x = state.camera.target.x,
+        .camera_y = state.camera.target.y,
+        .camera_offset_x = state.camera.offset.x,
+        .camera_offset_y = state.camera.offset.y,
+        .camera_zoom = state.camera.zoom,
+        .screen_width = state.screen_width,
+        .screen_height = state.screen_height,
+        .piece_size = state.piece_size,
+        .tick = state.sim.tick,
+    };
+    const bool is_scene_current
+        = state.is_paused && cache.is_scene_valid && !state.is_grid_dirty && scene_key == cache.scene_key;
+
+    if (state.is_grid_dirty) {
+        update_grid(state.sim, state.piece_size);
+        state.is_grid_dirty = false;
+    }
+    if (!is_scene_current) {
+        cull_pieces(
+            state.sim,
+            state.camera,
+            state.screen_width,
+            state.screen_height,
+            state.piece_size,
+            state.visible_pieces);
+    }
+
+    update_frame_pacing(state);
+
     BeginDrawing();
     {
-        state.window.ClearBackground(raylib::Color::RayWhite());
-
-        // Get blend value for position interpolation
-        float blend = state.fixed_loop.blend();
-        if (state.is_paused) {
-            blend = 1.0f;
+        if (is_scene_current) {
+            draw_render_texture(cache.scene);
+        }
+        else if (state.is_paused) {
+            // Keep the paused scene so the following frames only present it
+            update_render_texture_size(cache.scene, state.screen_width, state.screen_height);
+            cache.scene.BeginMode();
+            draw_scene(state, 1.0f);
+            cache.scene.EndMode();
+            cache.scene_key = scene_key;
+            cache.is_scene_valid = true;
+            draw_render_texture(cache.scene);
+        }
+        else {
+            cache.is_scene_valid = false;
+            draw_scene(state, state.fixed_loop.blend());
         }
 
-        draw_pieces(state.pieces, state.resources, blend);
+#if defined(RPS_PROFILE)
+        if (state.profiler_shown) {
+            draw_profiler_overlay(state);
+        }
+#endif
 
         // Draw UI
         if (state.hud_shown) {
-            draw_hud(state, state.ui_states);
+            draw_winner(state);
+            draw_cached_hud(state);
         }
         else {
             raylib::Rectangle hud_show_rect(static_cast<float>(state.screen_width - 30), 2, 25, 25);
             state.ui_states.hud_pressed = GuiButton(hud_show_rect, "#45#");
         }
     }
-    EndDrawing();
+    {
+        RPS_PROFILE_ZONE("End drawing");
+        EndDrawing();
+    }
 
-    state.audio_device.SetVolume(state.volume);
+    {
+        RPS_PROFILE_ZONE("Audio");
+        state.audio_device.SetVolume(state.volume);
+    }
 
     // Defaults
     if (state.ui_states.defaults_pressed) {
@@ -684,7 +1242,37 @@ static void main_loop(void* game_state_ptr)
 
     // Restart
     if (state.ui_states.restart_pressed || IsKeyPressed(KEY_SPACE)) {
-        state.pieces = init_pieces(state.piece_count, state.screen_width, state.screen_height);
+        reset_pieces(state.sim, state.piece_count);
+        state.is_grid_dirty = true;
+    }
+
+#if defined(RPS_PROFILE)
+    // Toggle profiler overlay
+    if (IsKeyPressed(KEY_F3)) {
+        state.profiler_shown = !state.profiler_shown;
+    }
+
+    // Toggle trace, stopped automatically after the configured duration
+    if (IsKeyPressed(KEY_T)
+        || (util::profile_trace_active() && GetTime() - state.trace_start_time >= state.config.trace_seconds)) {
+        toggle_trace(state);
+    }
+#endif
+
+    // Toggle frame recording
+    if (IsKeyPressed(KEY_R)) {
+        if (state.frame_recorder.is_open()) {
+            stop_recording(state.frame_recorder);
+        }
+        else {
+            try {
+                state.frame_recorder.open(state.config.record_path);
+                TraceLog(LOG_INFO, "Recording frames to %s", state.config.record_path.c_str());
+            }
+            catch (std::exception& e) {
+                TraceLog(LOG_WARNING, "%s", e.what());
+            }
+        }
     }
 
     // Toggle fullscreen
@@ -718,8 +1306,28 @@ static void main_loop(void* game_state_ptr)
     // Piece count
     if (state.ui_states.piece_count != state.piece_count) {
         state.piece_count = state.ui_states.piece_count;
-        state.pieces = update_piece_count(state.pieces, state.piece_count, state.screen_width, state.screen_height);
     }
+    if (state.sim.pieces.size() != state.piece_count) {
+        const int max_added_per_frame = 10000;
+        update_piece_count(state.sim, state.piece_count, max_added_per_frame);
+        if (state.selected_piece_index.has_value()
+            && state.selected_piece_index.value() >= state.sim.pieces.size()) {
+            state.selected_piece_index.reset();
+        }
+        state.is_grid_dirty = true;
+    }
+
+#if defined(RPS_TRACK_ALLOCATIONS)
+    // Steady state frames should not allocate, report any that do
+    const uint64_t frame_allocations = util::allocation_count() - allocations_start;
+    if (frame_allocations > 0) {
+        TraceLog(
+            LOG_WARNING,
+            "Frame at tick %llu made %llu heap allocations",
+            static_cast<unsigned long long>(state.sim.tick),
+            static_cast<unsigned long long>(frame_allocations));
+    }
+#endif
 }
 
 void run(const RockPaperScissorsConfig& config)
@@ -733,6 +1341,7 @@ void run(const RockPaperScissorsConfig& config)
     game_state.piece_size = config.piece_size;
     game_state.is_paused = false;
     game_state.hud_shown = true;
+    game_state.is_waiting_for_events = false;
     game_state.volume = 0.5f;
     game_state.selected_piece_index = {};
 
@@ -748,18 +1357,60 @@ void run(const RockPaperScissorsConfig& config)
     game_state.screen_width = window.GetWidth();
     game_state.screen_height = window.GetHeight();
 
+    game_state.sim.world = World {
+        .width = config.world_width,
+        .height = config.world_height,
+        .topology = config.world_topology,
+    };
+    fit_camera_to_world(
+        game_state.camera,
+        game_state.sim.world.width,
+        game_state.sim.world.height,
+        game_state.screen_width,
+        game_state.screen_height,
+        30);
+
     game_state.previous_windowed_size = window.GetSize();
 
     float volume = config.volume;
     game_state.audio_device.SetVolume(volume);
 
     SetExitKey(KEY_ESCAPE);
+    SetTargetFPS(config.max_fps);
 
     game_state.fixed_loop = util::FixedLoop(static_cast<float>(game_state.simulation_rate));
 
     game_state.resources = init_resources(game_state.piece_size);
 
-    game_state.pieces = init_pieces(game_state.piece_count, game_state.screen_width, game_state.screen_height);
+    game_state.sim.spawner.random.seed(static_cast<uint64_t>(std::time(nullptr)));
+    game_state.sim.random.seed(game_state.sim.spawner.random.next());
+    game_state.sim.spawner.placement = config.spawn_placement;
+    game_state.sim.thread_pool = &game_state.thread_pool;
+    const int worker_capacity = config.worker_processes > 0 ? std::max(game_state.piece_count, 1000) * 2 : 0;
+    check_memory_budget(
+        game_state.piece_count,
+        estimate_game_memory_bytes(game_state.piece_count, worker_capacity),
+        static_cast<size_t>(config.memory_budget_mb) * 1024 * 1024);
+    reset_pieces(game_state.sim, game_state.piece_count);
+    game_state.is_grid_dirty = true;
+
+    if (config.worker_processes > 0) {
+        try {
+            start_domain_workers(game_state.sim, config.worker_processes, worker_capacity);
+            TraceLog(LOG_INFO, "Simulating with %i worker processes", config.worker_processes);
+        }
+        catch (std::exception& e) {
+            TraceLog(LOG_WARNING, "%s", e.what());
+        }
+    }
+
+    if (config.trace_at_start) {
+#if defined(RPS_PROFILE)
+        toggle_trace(game_state);
+#else
+        TraceLog(LOG_WARNING, "Tracing requires profile zones, configure with RPS_PROFILE");
+#endif
+    }
 
 #if defined(PLATFORM_WEB)
     game_state.window.SetSize(web_canvas_width(), web_canvas_height());
@@ -769,6 +1420,12 @@ void run(const RockPaperScissorsConfig& config)
     while (!game_state.window.ShouldClose()) {
         main_loop(&game_state);
     }
+#if defined(RPS_PROFILE)
+    // Keep a trace that is still running when the window is closed
+    if (util::profile_trace_active()) {
+        toggle_trace(game_state);
+    }
+#endif
 #endif
 }
 
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <string>
+
 #include <raylib-cpp.hpp>
 
+#include "simulation.hpp"
+
 namespace rps {
 
 /**
@@ -10,16 +14,46 @@ namespace rps {
 struct RockPaperScissorsConfig {
     int screen_width;
     int screen_height;
+    // Size of the simulated area, independent of the window size
+    int world_width;
+    int world_height;
+    WorldTopology world_topology;
     float simulation_rate;
+    // Frames drawn per second are capped to this independently of the simulation rate, 0 only waits for VSync
+    int max_fps;
     int piece_size;
     int piece_count;
     float volume;
     int piece_samples;
+    MovementModel movement_model;
+    // Steering model only: maximum change of velocity per tick and fraction of velocity lost per tick
+    float max_acceleration;
+    float velocity_damping;
+    // Number of ticks a target is used before searching for a new one, 1 searches every tick
+    int target_refresh_ticks;
+    // A target is searched again early when its distance changes by more than this factor
+    float target_distance_band;
+    SpawnPlacement spawn_placement;
+    // Number of processes the world is split over for movement, 0 moves pieces in this process
+    int worker_processes;
+    // Every n-th tick is written when recording frames
+    int record_interval;
+    std::string record_path;
+    // Profile zones are written as a Chrome trace for this many seconds after tracing starts (T key, or at start)
+    bool trace_at_start;
+    float trace_seconds;
+    std::string trace_path;
+    // Starting fails when the estimated simulation memory is larger than this many megabytes, 0 for no limit
+    int memory_budget_mb;
+    // Ticks per second of the perf check scenarios, and the fraction they may drop before failing the check
+    std::string perf_baseline_path;
+    float perf_tolerance;
 };
 
 /**
  * @brief Run simulation
  * @param config - Initial configuration to start
+ * @throws std::runtime_error if the initial pieces do not fit in the memory budget
  */
 void run(const RockPaperScissorsConfig& config);
 
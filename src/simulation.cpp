@@ -0,0 +1,1570 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "profiler.hpp"
+
+namespace rps {
+
+/**
+ * @brief Create a piece without velocity or target
+ * @param type - Type of piece
+ * @return - Returns new piece
+ */
+static Piece make_piece(PieceType type)
+{
+    return Piece {
+        .vel = {},
+        .target = -1,
+        .target_dist = 0.0f,
+        .target_ticks = 0,
+        .type = type,
+        .target_type = PieceType::e_rock,
+    };
+}
+
+#if defined(RPS_COMPACT)
+// Steps of packed vectors and positions per pixel
+static constexpr float c_packed_scale = 256.0f;
+
+/**
+ * @brief Convert a vector to 16-bit fixed point, clamping components that are out of range
+ * @param vector - Vector in pixels
+ * @return - Returns packed vector
+ */
+static PackedVector pack_vector(raylib::Vector2 vector)
+{
+    const auto pack = [](float value) {
+        return static_cast<int16_t>(std::clamp(std::round(value * c_packed_scale), -32768.0f, 32767.0f));
+    };
+    return PackedVector { pack(vector.x), pack(vector.y) };
+}
+
+/**
+ * @brief Convert a 16-bit fixed point vector to pixels
+ * @param vector - Packed vector
+ * @return - Returns vector in pixels
+ */
+static raylib::Vector2 unpack_vector(PackedVector vector)
+{
+    return raylib::Vector2(
+        static_cast<float>(vector.x) / c_packed_scale, static_cast<float>(vector.y) / c_packed_scale);
+}
+
+/**
+ * @brief Split fixed point coordinates into the chunk and the offset in the chunk
+ * @param x - Horizontal coordinate in steps of 1/256 of a pixel, chunk index in the upper 16 bits
+ * @param y - Vertical coordinate in steps of 1/256 of a pixel, chunk index in the upper 16 bits
+ * @return - Returns packed position
+ */
+static PackedPosition make_packed_position(int64_t x, int64_t y)
+{
+    return PackedPosition {
+        .x = static_cast<uint16_t>(x & 0xffff),
+        .y = static_cast<uint16_t>(y & 0xffff),
+        .chunk_x = static_cast<uint16_t>(x >> 16),
+        .chunk_y = static_cast<uint16_t>(y >> 16),
+    };
+}
+
+/**
+ * @brief Get horizontal fixed point coordinate of a packed position, see make_packed_position
+ */
+static int64_t fixed_x(PackedPosition pos)
+{
+    return static_cast<int64_t>(pos.chunk_x) << 16 | pos.x;
+}
+
+/**
+ * @brief Get vertical fixed point coordinate of a packed position, see make_packed_position
+ */
+static int64_t fixed_y(PackedPosition pos)
+{
+    return static_cast<int64_t>(pos.chunk_y) << 16 | pos.y;
+}
+
+/**
+ * @brief Convert a position to its chunk and 16-bit fixed point offset, clamping it to the packed range
+ * @param pos - Position in pixels
+ * @return - Returns packed position
+ */
+static PackedPosition pack_position(raylib::Vector2 pos)
+{
+    const auto fixed = [](float value) {
+        return std::clamp(static_cast<int64_t>(std::round(value * c_packed_scale)), int64_t(0), int64_t(0xffffffff));
+    };
+    return make_packed_position(fixed(pos.x), fixed(pos.y));
+}
+
+/**
+ * @brief Convert a packed position to pixels
+ * @param pos - Packed position
+ * @return - Returns position in pixels
+ */
+static raylib::Vector2 unpack_position(PackedPosition pos)
+{
+    const float chunk_size = static_cast<float>(c_chunk_size);
+    return raylib::Vector2(
+        static_cast<float>(pos.chunk_x) * chunk_size + static_cast<float>(pos.x) / c_packed_scale,
+        static_cast<float>(pos.chunk_y) * chunk_size + static_cast<float>(pos.y) / c_packed_scale);
+}
+
+/**
+ * @brief Add a displacement to a packed position in fixed point, clamping or wrapping it like world_constrain
+ * @param world - World the position is in
+ * @param piece_size - Size of piece
+ * @param pos - Packed position
+ * @param delta - Displacement
+ * @return - Returns moved packed position
+ */
+static PackedPosition move_packed_position(const World& world, int piece_size, PackedPosition pos, PackedVector delta)
+{
+    const auto scale = static_cast<int64_t>(c_packed_scale);
+    int64_t x = fixed_x(pos) + delta.x;
+    int64_t y = fixed_y(pos) + delta.y;
+    switch (world.topology) {
+    case WorldTopology::e_bounded:
+        x = std::clamp(x, int64_t(0), std::max(int64_t(0), (world.width - piece_size) * scale));
+        y = std::clamp(y, int64_t(0), std::max(int64_t(0), (world.height - piece_size) * scale));
+        break;
+    case WorldTopology::e_toroidal: {
+        const int64_t width = std::max(int64_t(1), world.width * scale);
+        const int64_t height = std::max(int64_t(1), world.height * scale);
+        x = (x % width + width) % width;
+        y = (y % height + height) % height;
+        break;
+    }
+    }
+    return make_packed_position(x, y);
+}
+#endif
+
+/**
+ * @brief Get velocity of a piece in pixels per tick
+ * @param p - Piece
+ * @return - Returns velocity
+ */
+static raylib::Vector2 velocity(const Piece& p)
+{
+#if defined(RPS_COMPACT)
+    return unpack_vector(p.vel);
+#else
+    return p.vel;
+#endif
+}
+
+/**
+ * @brief Set velocity of a piece in pixels per tick
+ * @param p - Piece
+ * @param vel - New velocity
+ */
+static void set_velocity(Piece& p, raylib::Vector2 vel)
+{
+#if defined(RPS_COMPACT)
+    p.vel = pack_vector(vel);
+#else
+    p.vel = vel;
+#endif
+}
+
+// Bytes of the position buffers per piece
+#if defined(RPS_COMPACT)
+static constexpr size_t c_position_bytes = sizeof(PackedPosition) + sizeof(PackedVector);
+#else
+static constexpr size_t c_position_bytes = sizeof(raylib::Vector2) * 2;
+#endif
+
+/**
+ * @brief Call a function with every per-piece position buffer
+ * @param sim - Simulation whose buffers are visited
+ * @param func - Callable taking a buffer
+ */
+template <typename Func>
+static void for_each_position_buffer(Simulation& sim, Func&& func)
+{
+#if defined(RPS_COMPACT)
+    func(sim.packed_positions);
+    func(sim.position_deltas);
+#else
+    for (std::pmr::vector<raylib::Vector2>& positions : sim.position_buffers) {
+        func(positions);
+    }
+#endif
+}
+
+/**
+ * @brief Append a piece to the index list of its type
+ * @param sim - Simulation the piece is in
+ * @param index - Index of piece
+ */
+static void add_type_index(Simulation& sim, int index)
+{
+    std::pmr::vector<int>& indices = sim.type_indices[static_cast<int>(sim.pieces[index].type)];
+    sim.type_slots[index] = static_cast<int>(indices.size());
+    indices.push_back(index);
+}
+
+/**
+ * @brief Remove a piece from the index list of its type by moving the last index of the list into its slot
+ * @param sim - Simulation the piece is in
+ * @param index - Index of piece
+ */
+static void remove_type_index(Simulation& sim, int index)
+{
+    std::pmr::vector<int>& indices = sim.type_indices[static_cast<int>(sim.pieces[index].type)];
+    const int slot = sim.type_slots[index];
+    const int last = indices.back();
+    indices[slot] = last;
+    sim.type_slots[last] = slot;
+    indices.pop_back();
+}
+
+/**
+ * @brief Rebuild index lists of all piece types from scratch
+ * @param sim - Simulation to update
+ */
+static void rebuild_type_indices(Simulation& sim)
+{
+    for (std::pmr::vector<int>& indices : sim.type_indices) {
+        indices.clear();
+    }
+    sim.type_slots.resize(sim.pieces.size());
+    for (int i = 0; i < sim.pieces.size(); i++) {
+        add_type_index(sim, i);
+    }
+}
+
+void set_piece_type(Simulation& sim, int index, PieceType type)
+{
+    if (sim.pieces[index].type == type) {
+        return;
+    }
+    remove_type_index(sim, index);
+    sim.pieces[index].type = type;
+    add_type_index(sim, index);
+}
+
+std::optional<PieceType> winner(const Simulation& sim)
+{
+    std::optional<PieceType> remaining;
+    for (int type = 0; type < 3; type++) {
+        if (!sim.type_indices[type].empty()) {
+            if (remaining.has_value()) {
+                return {};
+            }
+            remaining = static_cast<PieceType>(type);
+        }
+    }
+    return remaining;
+}
+
+/**
+ * @brief Append randomly placed pieces to pieces list
+ * @param sim - Simulation to add pieces to
+ * @param count - Number of pieces to add
+ */
+static void add_pieces(Simulation& sim, int count)
+{
+    util::Random& random = sim.spawner.random;
+    for (int i = 0; i < count; i++) {
+        raylib::Vector2 random_pos(
+            random.uniform(0.0f, static_cast<float>(sim.world.width)),
+            random.uniform(0.0f, static_cast<float>(sim.world.height)));
+        const int index = static_cast<int>(sim.pieces.size());
+        sim.pieces.push_back(make_piece(static_cast<PieceType>(index % 3)));
+        // A new piece did not move, its previous position is the same as its current one
+#if defined(RPS_COMPACT)
+        sim.packed_positions.push_back(pack_position(random_pos));
+        sim.position_deltas.push_back(PackedVector {});
+#else
+        for (std::pmr::vector<raylib::Vector2>& positions : sim.position_buffers) {
+            positions.push_back(random_pos);
+        }
+#endif
+        sim.type_slots.push_back(0);
+        add_type_index(sim, index);
+    }
+}
+
+/**
+ * @brief Fill spawner buffers with the positions of a range of pieces
+ *
+ * Stratified placement puts one piece per cell of a jittered grid over the whole population, in index order.
+ * @param spawner - Spawner with buffers sized to at least count
+ * @param world - World to place pieces in
+ * @param begin - Index of the first piece of the range
+ * @param count - Number of pieces in the range
+ * @param total - Number of pieces spawned
+ */
+static void fill_spawn_positions(Spawner& spawner, const World& world, int begin, int count, int total)
+{
+    const float width = static_cast<float>(world.width);
+    const float height = static_cast<float>(world.height);
+    switch (spawner.placement) {
+    case SpawnPlacement::e_uniform:
+        spawner.random.fill_uniform(spawner.x.data(), count, 0.0f, width);
+        spawner.random.fill_uniform(spawner.y.data(), count, 0.0f, height);
+        break;
+    case SpawnPlacement::e_stratified: {
+        const int cols
+            = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<float>(total) * width / height))));
+        const int rows = std::max(1, (total + cols - 1) / cols);
+        const int cells = cols * rows;
+        const float cell_width = width / static_cast<float>(cols);
+        const float cell_height = height / static_cast<float>(rows);
+
+        // Jitter within the cell is generated in bulk, then offset by the cell origin
+        spawner.random.fill_uniform(spawner.x.data(), count, 0.0f, cell_width);
+        spawner.random.fill_uniform(spawner.y.data(), count, 0.0f, cell_height);
+        for (int i = 0; i < count; i++) {
+            // Spread pieces evenly over cells when the grid has more cells than pieces
+            int cell = static_cast<int>(static_cast<int64_t>(begin + i) * cells / total);
+            spawner.x[i] += static_cast<float>(cell % cols) * cell_width;
+            spawner.y[i] += static_cast<float>(cell / cols) * cell_height;
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Shuffle positions of stratified pieces so piece types are not laid out in stripes
+ * @param random - Random source
+ * @param count - Number of pieces
+ * @param swap - Callable swapping the positions of two pieces
+ */
+template <typename Swap>
+static void shuffle_positions(util::Random& random, int count, Swap&& swap)
+{
+    for (int i = count - 1; i > 0; i--) {
+        swap(i, random.range(0, i));
+    }
+}
+
+void reset_pieces(Simulation& sim, int count)
+{
+    Spawner& spawner = sim.spawner;
+    sim.pieces.resize(count);
+
+#if defined(RPS_COMPACT)
+    if (sim.world.width > c_max_compact_world_size || sim.world.height > c_max_compact_world_size) {
+        throw std::runtime_error(
+            "World of " + std::to_string(sim.world.width) + "x" + std::to_string(sim.world.height)
+            + " is larger than packed positions reach");
+    }
+    // Positions are spawned in blocks, so the spawn buffers do not add 8 bytes per piece
+    const int block_size = 4096;
+    spawner.x.resize(block_size);
+    spawner.y.resize(block_size);
+    sim.packed_positions.resize(count);
+    sim.position_deltas.assign(count, PackedVector {});
+    for (int begin = 0; begin < count; begin += block_size) {
+        const int block_count = std::min(block_size, count - begin);
+        fill_spawn_positions(spawner, sim.world, begin, block_count, count);
+        for (int i = 0; i < block_count; i++) {
+            sim.packed_positions[begin + i] = pack_position(raylib::Vector2(spawner.x[i], spawner.y[i]));
+        }
+    }
+    if (spawner.placement == SpawnPlacement::e_stratified) {
+        shuffle_positions(
+            spawner.random, count, [&](int i, int j) { std::swap(sim.packed_positions[i], sim.packed_positions[j]); });
+    }
+#else
+    spawner.x.resize(count);
+    spawner.y.resize(count);
+    fill_spawn_positions(spawner, sim.world, 0, count, count);
+    if (spawner.placement == SpawnPlacement::e_stratified) {
+        shuffle_positions(spawner.random, count, [&](int i, int j) {
+            std::swap(spawner.x[i], spawner.x[j]);
+            std::swap(spawner.y[i], spawner.y[j]);
+        });
+    }
+    for (std::pmr::vector<raylib::Vector2>& positions : sim.position_buffers) {
+        positions.resize(count);
+        for (int i = 0; i < count; i++) {
+            positions[i] = raylib::Vector2(spawner.x[i], spawner.y[i]);
+        }
+    }
+#endif
+
+    for (int i = 0; i < count; i++) {
+        sim.pieces[i] = make_piece(static_cast<PieceType>(i % 3));
+    }
+    rebuild_type_indices(sim);
+}
+
+/**
+ * @brief Reserve storage of the per-piece buffers for a number of pieces
+ * @param sim - Simulation whose buffers are reserved
+ * @param count - Number of pieces, at least the current one
+ */
+static void reserve_pieces(Simulation& sim, int count)
+{
+    sim.pieces.reserve(count);
+    for_each_position_buffer(sim, [&](auto& positions) { positions.reserve(count); });
+    sim.type_slots.reserve(count);
+    // Pieces are added in type order, so each type list gets a third of the new pieces
+    const size_t added_per_type = (count - sim.pieces.size() + 2) / 3;
+    for (std::pmr::vector<int>& indices : sim.type_indices) {
+        indices.reserve(indices.size() + added_per_type);
+    }
+}
+
+void update_piece_count(Simulation& sim, int new_count, int max_added)
+{
+    if (sim.pieces.size() < new_count) {
+        // The whole new count is reserved by the first call, so the calls adding the rest do not reallocate
+        reserve_pieces(sim, new_count);
+        int added = std::min(static_cast<int>(new_count - sim.pieces.size()), max_added);
+        add_pieces(sim, added);
+    }
+    else {
+        for (int i = static_cast<int>(sim.pieces.size()) - 1; i >= new_count; i--) {
+            remove_type_index(sim, i);
+        }
+        sim.pieces.resize(new_count);
+        for_each_position_buffer(sim, [&](auto& positions) { positions.resize(new_count); });
+        sim.type_slots.resize(new_count);
+    }
+}
+
+/**
+ * @brief Position, displacement or velocity in the scalar type tick math is done in
+ *
+ * Operations are the same as the raylib vector operations, so with float the results match them bit for bit.
+ */
+template <typename Scalar>
+struct TickVector {
+    Scalar x;
+    Scalar y;
+
+    TickVector operator+(TickVector other) const
+    {
+        return TickVector { x + other.x, y + other.y };
+    }
+
+    TickVector operator-(TickVector other) const
+    {
+        return TickVector { x - other.x, y - other.y };
+    }
+
+    TickVector operator*(Scalar scale) const
+    {
+        return TickVector { x * scale, y * scale };
+    }
+
+    TickVector operator-() const
+    {
+        return TickVector { -x, -y };
+    }
+
+    [[nodiscard]] Scalar length_sqr() const
+    {
+        return x * x + y * y;
+    }
+
+    [[nodiscard]] Scalar length() const
+    {
+        using std::sqrt;
+        return sqrt(length_sqr());
+    }
+
+    [[nodiscard]] TickVector normalized() const
+    {
+        const Scalar len = length();
+        if (len <= Scalar(0.0f)) {
+            return TickVector { Scalar(0.0f), Scalar(0.0f) };
+        }
+        // Fixed point divides each component, its reciprocal of a long vector would keep only a few significant bits
+        if constexpr (std::is_same_v<Scalar, float>) {
+            const Scalar inverse = Scalar(1.0f) / len;
+            return TickVector { x * inverse, y * inverse };
+        }
+        else {
+            return TickVector { x / len, y / len };
+        }
+    }
+};
+
+/**
+ * @brief Convert a stored position or velocity to the scalar type tick math is done in
+ * @tparam Scalar - float or util::Fixed
+ * @param vector - Stored vector
+ * @return - Returns converted vector
+ */
+template <typename Scalar>
+static TickVector<Scalar> to_tick_vector(raylib::Vector2 vector)
+{
+    return TickVector<Scalar> { Scalar(vector.x), Scalar(vector.y) };
+}
+
+/**
+ * @brief Convert a vector back to the stored float representation
+ * @tparam Scalar - float or util::Fixed
+ * @param vector - Vector to convert
+ * @return - Returns float vector
+ */
+template <typename Scalar>
+static raylib::Vector2 to_vector2(TickVector<Scalar> vector)
+{
+    return raylib::Vector2(static_cast<float>(vector.x), static_cast<float>(vector.y));
+}
+
+/**
+ * @brief Get shortest displacement between two positions, see world_delta
+ */
+template <typename Scalar>
+static TickVector<Scalar> tick_delta(const World& world, TickVector<Scalar> from, TickVector<Scalar> to)
+{
+    TickVector<Scalar> delta = to - from;
+    if (world.topology == WorldTopology::e_toroidal) {
+        using std::round;
+        const Scalar width(static_cast<float>(world.width));
+        const Scalar height(static_cast<float>(world.height));
+        delta.x -= width * round(delta.x / width);
+        delta.y -= height * round(delta.y / height);
+    }
+    return delta;
+}
+
+/**
+ * @brief Keep a piece position inside the world, see world_constrain
+ */
+template <typename Scalar>
+static TickVector<Scalar> tick_constrain(const World& world, TickVector<Scalar> pos, int piece_size)
+{
+    const Scalar width(static_cast<float>(world.width));
+    const Scalar height(static_cast<float>(world.height));
+    const Scalar size(static_cast<float>(piece_size));
+    using std::floor;
+    switch (world.topology) {
+    case WorldTopology::e_bounded:
+        pos.x = std::clamp(pos.x, Scalar(0.0f), width - size);
+        pos.y = std::clamp(pos.y, Scalar(0.0f), height - size);
+        break;
+    case WorldTopology::e_toroidal:
+        pos.x -= width * floor(pos.x / width);
+        pos.y -= height * floor(pos.y / height);
+        break;
+    }
+    return pos;
+}
+
+raylib::Vector2 world_delta(const World& world, raylib::Vector2 from, raylib::Vector2 to)
+{
+    return to_vector2(tick_delta(world, to_tick_vector<float>(from), to_tick_vector<float>(to)));
+}
+
+raylib::Vector2 world_constrain(const World& world, raylib::Vector2 pos, int piece_size)
+{
+    return to_vector2(tick_constrain(world, to_tick_vector<float>(pos), piece_size));
+}
+
+raylib::Vector2 position(const Simulation& sim, int index)
+{
+#if defined(RPS_COMPACT)
+    return unpack_position(sim.packed_positions[index]);
+#else
+    return sim.position_buffers[sim.current_buffer][index];
+#endif
+}
+
+void set_position(Simulation& sim, int index, raylib::Vector2 pos)
+{
+#if defined(RPS_COMPACT)
+    sim.packed_positions[index] = pack_position(pos);
+    sim.position_deltas[index] = PackedVector {};
+#else
+    for (std::pmr::vector<raylib::Vector2>& positions : sim.position_buffers) {
+        positions[index] = pos;
+    }
+#endif
+}
+
+raylib::Vector2 interpolate_pos(const Simulation& sim, int index, float blend)
+{
+#if defined(RPS_COMPACT)
+    // The delta is the shortest displacement, so going back along it does not cross the world when the piece wrapped
+    const raylib::Vector2 delta = unpack_vector(sim.position_deltas[index]);
+    return position(sim, index) - delta * (1.0f - blend);
+#else
+    const raylib::Vector2 prev_pos = sim.position_buffers[1 - sim.current_buffer][index];
+    return prev_pos + world_delta(sim.world, prev_pos, position(sim, index)) * blend;
+#endif
+}
+
+#if defined(RPS_COMPACT)
+/**
+ * @brief Pieces being moved, the positions they are moved from and the displacements their moves are written to
+ *
+ * Each piece only writes its own state and displacement, and only reads the positions of other pieces. The positions
+ * are not written until all pieces moved.
+ */
+struct MoveBuffers {
+    std::span<Piece> pieces;
+    std::span<const PackedPosition> prev_positions;
+    std::span<PackedVector> deltas;
+};
+#else
+/**
+ * @brief Pieces being moved, the positions they are moved from and the buffer their new positions are written to
+ *
+ * Each piece only writes its own state and new position, and only reads the previous positions of other pieces.
+ */
+struct MoveBuffers {
+    std::span<Piece> pieces;
+    std::span<const raylib::Vector2> prev_positions;
+    std::span<raylib::Vector2> positions;
+};
+#endif
+
+/**
+ * @brief Get position of a piece before it moves
+ * @param buffers - Pieces being moved
+ * @param index - Index of piece
+ * @return - Returns previous position
+ */
+static raylib::Vector2 prev_position(const MoveBuffers& buffers, int index)
+{
+#if defined(RPS_COMPACT)
+    return unpack_position(buffers.prev_positions[index]);
+#else
+    return buffers.prev_positions[index];
+#endif
+}
+
+/**
+ * @brief Write new position of a moved piece
+ * @param buffers - Pieces being moved
+ * @param world - World the piece is in
+ * @param index - Index of piece
+ * @param pos - New position, inside the world
+ */
+static void write_position(const MoveBuffers& buffers, const World& world, int index, raylib::Vector2 pos)
+{
+#if defined(RPS_COMPACT)
+    buffers.deltas[index] = pack_vector(world_delta(world, prev_position(buffers, index), pos));
+#else
+    buffers.positions[index] = pos;
+#endif
+}
+
+/**
+ * @brief Get new position of a moved piece
+ * @param buffers - Pieces being moved
+ * @param world - World the piece is in
+ * @param piece_size - Size of piece
+ * @param index - Index of piece
+ * @return - Returns new position
+ */
+static raylib::Vector2 moved_position(const MoveBuffers& buffers, const World& world, int piece_size, int index)
+{
+#if defined(RPS_COMPACT)
+    return unpack_position(
+        move_packed_position(world, piece_size, buffers.prev_positions[index], buffers.deltas[index]));
+#else
+    return buffers.positions[index];
+#endif
+}
+
+/**
+ * @brief Gets closest piece of a different type from a number of random samples
+ *
+ * Samples are drawn only from the pieces of the two other types, so the cost is exactly the number of samples no
+ * matter how the population is split between types.
+ * @param buffers - Pieces and their previous positions
+ * @param by_type - Indices of pieces of each type
+ * @param world - World the pieces are in
+ * @param piece_index - Piece to search from
+ * @param samples - Number of samples to search
+ * @param random - Random source
+ * @return - Returns index of estimated random piece or null if one could not be found
+ */
+template <typename Scalar>
+static std::optional<int> estimate_closest_diff_piece(
+    const MoveBuffers& buffers,
+    const TypeIndexView& by_type,
+    const World& world,
+    int piece_index,
+    int samples,
+    util::Random& random)
+{
+    const int type = static_cast<int>(buffers.pieces[piece_index].type);
+    const auto pos = to_tick_vector<Scalar>(prev_position(buffers, piece_index));
+    const std::span<const int> first = by_type[(type + 1) % 3];
+    const std::span<const int> second = by_type[(type + 2) % 3];
+    const int first_count = static_cast<int>(first.size());
+    const int candidate_count = first_count + static_cast<int>(second.size());
+    if (candidate_count == 0) {
+        return {};
+    }
+
+    Scalar min_dist {};
+    std::optional<int> min_piece_index;
+    for (int i = 0; i < samples; i++) {
+        // Pick uniformly among all pieces of the other types
+        const int candidate = random.range(0, candidate_count - 1);
+        const int rand_index = candidate < first_count ? first[candidate] : second[candidate - first_count];
+        const Scalar dist
+            = tick_delta(world, pos, to_tick_vector<Scalar>(prev_position(buffers, rand_index))).length_sqr();
+        if (!min_piece_index.has_value() || dist < min_dist) {
+            min_dist = dist;
+            min_piece_index = rand_index;
+        }
+    }
+
+    return min_piece_index;
+}
+
+/**
+ * @brief Determine if pieces are attracted
+ * @param p1 - Piece 1
+ * @param p2 - Piece 2
+ * @return - Returns a bool optional, true if attracted, false if repelled, null if no interaction
+ */
+static std::optional<bool> are_pieces_attracted(const Piece& p1, const Piece& p2)
+{
+    switch (p1.type) {
+    case PieceType::e_rock:
+        switch (p2.type) {
+        case PieceType::e_rock:
+            return {};
+        case PieceType::e_paper:
+            return false;
+        case PieceType::e_scissors:
+            return true;
+        }
+    case PieceType::e_paper:
+        switch (p2.type) {
+        case PieceType::e_rock:
+            return true;
+        case PieceType::e_paper:
+            return {};
+        case PieceType::e_scissors:
+            return false;
+        }
+    case PieceType::e_scissors:
+        switch (p2.type) {
+        case PieceType::e_rock:
+            return false;
+        case PieceType::e_paper:
+            return true;
+        case PieceType::e_scissors:
+            return {};
+        }
+    }
+    return {};
+}
+
+/**
+ * @brief Get cached target of a piece, searching for a new one only when the cached target is no longer valid
+ *
+ * A cached target is searched again when its refresh budget expired, it or the piece converted, or its distance
+ * moved out of the band around the distance it was found at.
+ * @param buffers - Pieces and their previous positions
+ * @param by_type - Indices of pieces of each type
+ * @param world - World the pieces are in
+ * @param movement - Movement parameters
+ * @param index - Index of piece to get target of
+ * @param random_seed - Seed of the tick, the samples of a piece are drawn from it and the piece index
+ * @param stats - Cache statistics to update
+ * @return - Returns index of target piece or null if one could not be found
+ */
+template <typename Scalar>
+static std::optional<int> cached_closest_diff_piece(
+    const MoveBuffers& buffers,
+    const TypeIndexView& by_type,
+    const World& world,
+    const Movement& movement,
+    int index,
+    uint64_t random_seed,
+    TargetCacheStats& stats)
+{
+    Piece& p = buffers.pieces[index];
+    const auto pos = to_tick_vector<Scalar>(prev_position(buffers, index));
+    if (p.target_ticks > 0 && p.target >= 0 && p.target < buffers.pieces.size()) {
+        const Piece& target = buffers.pieces[p.target];
+        const auto target_pos = to_tick_vector<Scalar>(prev_position(buffers, p.target));
+        const Scalar dist = tick_delta(world, pos, target_pos).length_sqr();
+        const Scalar band_factor(movement.target_distance_band);
+        const Scalar band = band_factor * band_factor;
+        const Scalar target_dist(p.target_dist);
+        if (target.type == p.target_type && target.type != p.type && dist <= target_dist * band
+            && dist * band >= target_dist) {
+            p.target_ticks--;
+            stats.hits++;
+            return p.target;
+        }
+    }
+
+    stats.misses++;
+    // Samples only depend on the tick and the piece, not on which thread or process moves the piece
+    util::Random random(random_seed + static_cast<uint64_t>(index));
+    std::optional<int> target
+        = estimate_closest_diff_piece<Scalar>(buffers, by_type, world, index, movement.samples, random);
+    p.target = target.value_or(-1);
+    p.target_ticks = static_cast<uint16_t>(std::clamp(movement.target_refresh_ticks - 1, 0, c_max_target_ticks));
+    if (target.has_value()) {
+        p.target_type = buffers.pieces[target.value()].type;
+        const auto target_pos = to_tick_vector<Scalar>(prev_position(buffers, target.value()));
+        p.target_dist = static_cast<float>(tick_delta(world, pos, target_pos).length_sqr());
+    }
+    return target;
+}
+
+/**
+ * @brief Accelerate piece towards a desired velocity and move it
+ * @param p - Piece to accelerate
+ * @param pos - Previous position of piece
+ * @param desired_vel - Velocity the piece steers towards
+ * @param movement - Movement parameters
+ * @return - Returns new position of piece
+ */
+template <typename Scalar>
+static TickVector<Scalar> steer_piece(
+    Piece& p, TickVector<Scalar> pos, TickVector<Scalar> desired_vel, const Movement& movement)
+{
+    const auto vel = to_tick_vector<Scalar>(velocity(p));
+    TickVector<Scalar> accel = desired_vel - vel;
+    const Scalar accel_length = accel.length();
+    const Scalar max_acceleration(movement.max_acceleration);
+    if (accel_length > max_acceleration) {
+        accel = accel * (max_acceleration / accel_length);
+    }
+    const TickVector<Scalar> new_vel = (vel + accel) * (Scalar(1.0f) - Scalar(movement.damping));
+    set_velocity(p, to_vector2(new_vel));
+    return pos + new_vel;
+}
+
+/**
+ * @brief Calculate new position of a piece from the previous positions of all pieces
+ * @tparam Scalar - Type distances, velocities and the new position are computed in
+ * @param buffers - Pieces, their previous positions and the buffer the new position is written to
+ * @param by_type - Indices of pieces of each type
+ * @param world
+ * @param movement
+ * @param index - Index of piece to move
+ * @param random_seed - Seed of the tick for sampling
+ * @param stats - Target cache statistics to update
+ */
+template <typename Scalar>
+static void update_piece_pos(
+    const MoveBuffers& buffers,
+    const TypeIndexView& by_type,
+    const World& world,
+    const Movement& movement,
+    int index,
+    uint64_t random_seed,
+    TargetCacheStats& stats)
+{
+    const Scalar repel_speed(1.0f);
+    const Scalar attract_speed(2.0f);
+
+    Piece& p1 = buffers.pieces[index];
+    const auto pos = to_tick_vector<Scalar>(prev_position(buffers, index));
+
+    // Get the closest different piece from a number of samples, or the cached one while it is still valid
+    std::optional<int> min_piece_index
+        = cached_closest_diff_piece<Scalar>(buffers, by_type, world, movement, index, random_seed, stats);
+
+    // Desired velocity is zero if a close piece cannot be found or pieces are the same
+    TickVector<Scalar> vel { Scalar(0.0f), Scalar(0.0f) };
+    if (min_piece_index.has_value()) {
+        const Piece& p2 = buffers.pieces[min_piece_index.value()];
+
+        // Calculate interaction
+        std::optional<bool> is_attracted = are_pieces_attracted(p1, p2);
+
+        if (is_attracted.has_value()) {
+            const auto target_pos = to_tick_vector<Scalar>(prev_position(buffers, min_piece_index.value()));
+            const TickVector<Scalar> dir = tick_delta(world, pos, target_pos).normalized();
+            if (is_attracted.value()) {
+                vel = dir * attract_speed;
+            }
+            else {
+                vel = -(dir * repel_speed);
+            }
+        }
+    }
+
+    TickVector<Scalar> new_pos = pos;
+    switch (movement.model) {
+    case MovementModel::e_direct:
+        new_pos = pos + vel;
+        break;
+    case MovementModel::e_steering:
+        new_pos = steer_piece(p1, pos, vel, movement);
+        break;
+    }
+
+    // Clamp or wrap positions so they cannot leave the world
+    write_position(buffers, world, index, to_vector2(tick_constrain(world, new_pos, movement.piece_size)));
+}
+
+/**
+ * @brief Calculate new pieces positions, split into chunks over the thread pool if there is one
+ *
+ * Positions are computed from the read-only previous positions and types of other pieces and written to the other
+ * buffer, so chunks move their pieces independently and in any order.
+ * @param sim - Simulation to update
+ * @param buffers - Pieces, their previous positions and the buffer new positions are written to
+ * @param movement - Movement parameters
+ * @param random_seed - Seed of the tick for sampling
+ */
+template <typename Scalar>
+static void update_pieces_pos(
+    Simulation& sim, const MoveBuffers& buffers, const Movement& movement, uint64_t random_seed)
+{
+    const TypeIndexView by_type { sim.type_indices[0], sim.type_indices[1], sim.type_indices[2] };
+    const auto move_chunk = [&](int begin, int end) {
+        TargetCacheStats stats {};
+        for (int i = begin; i < end; i++) {
+            update_piece_pos<Scalar>(buffers, by_type, sim.world, movement, i, random_seed, stats);
+        }
+        std::atomic_ref(sim.target_stats.hits).fetch_add(stats.hits, std::memory_order_relaxed);
+        std::atomic_ref(sim.target_stats.misses).fetch_add(stats.misses, std::memory_order_relaxed);
+    };
+
+    const int count = static_cast<int>(sim.pieces.size());
+    if (sim.thread_pool != nullptr) {
+        sim.thread_pool->parallel_for(count, 1024, move_chunk);
+    }
+    else {
+        move_chunk(0, count);
+    }
+}
+
+/**
+ * @brief Header of memory shared with domain worker processes, followed by the group bounds and orders of the pieces
+ * each worker owns, and by the arena the simulation buffers are allocated from
+ *
+ * The workers are forked after the memory is mapped, so it is at the same address in every process and the buffer
+ * pointers are valid in the workers too.
+ */
+struct DomainShared {
+    World world;
+    Movement movement;
+    int piece_count;
+    int piece_capacity;
+    uint64_t random_seed;
+    // Tick math is done in util::Fixed instead of float
+    bool is_fixed_point;
+    // Simulation buffers, read and written in place by the workers
+    MoveBuffers buffers;
+    std::array<const int*, 3> type_indices;
+    std::array<int, 3> type_counts;
+    // Each worker writes the pieces it moved to its own range of the next order, grouped by the strip their new
+    // position is in. The worker_count + 1 group bounds of each worker follow each other, so a worker owns its strip's
+    // group of every worker. Orders and bounds are double buffered and swapped after every tick
+    std::array<int*, 2> orders;
+    std::array<int*, 2> bounds;
+    int current_order;
+    // Number of pieces in the current order, it is only used while the piece count stays the same
+    int order_count;
+    // Target cache statistics summed over all workers
+    std::atomic<uint64_t> target_hits;
+    std::atomic<uint64_t> target_misses;
+};
+
+/**
+ * @brief Get the horizontal strip of the world a position is in
+ * @param pos - Piece position
+ * @param strip_height - Height of every strip
+ * @param worker_count - Number of workers and strips
+ * @return - Returns index of strip
+ */
+static int domain_strip(raylib::Vector2 pos, float strip_height, int worker_count)
+{
+    return std::clamp(static_cast<int>(pos.y / strip_height), 0, worker_count - 1);
+}
+
+/**
+ * @brief Check if the pieces of the current order are used, they are not after a restart or a piece count change
+ * @param shared - Shared memory
+ * @return - Returns true if workers own the pieces in the current order
+ */
+static bool is_domain_order_valid(const DomainShared& shared)
+{
+    return shared.order_count == shared.piece_count;
+}
+
+/**
+ * @brief Get where the range of a worker starts in the next order
+ * @param worker_index - Index of worker
+ * @param worker_count - Number of workers
+ * @param shared - Shared memory
+ * @return - Returns number of pieces owned by the workers before it
+ */
+static int domain_range_start(int worker_index, int worker_count, const DomainShared& shared)
+{
+    if (!is_domain_order_valid(shared)) {
+        return static_cast<int>(static_cast<int64_t>(shared.piece_count) * worker_index / worker_count);
+    }
+    const int* bounds = shared.bounds[shared.current_order];
+    int start = 0;
+    for (int worker = 0; worker < worker_count; worker++) {
+        const int* groups = bounds + worker * (worker_count + 1);
+        start += groups[worker_index] - groups[0];
+    }
+    return start;
+}
+
+/**
+ * @brief Call a function with the index of every piece a worker owns
+ *
+ * A worker owns the pieces that were in its strip after the last tick. Without a valid order each worker owns an
+ * equal range of indices for one tick, then the pieces are handed over to the workers of their strips.
+ * @param worker_index - Index of worker
+ * @param worker_count - Number of workers
+ * @param shared - Shared memory
+ * @param func - Callable taking the piece index
+ */
+template <typename Func>
+static void for_each_owned_piece(int worker_index, int worker_count, const DomainShared& shared, Func&& func)
+{
+    if (!is_domain_order_valid(shared)) {
+        const int begin = domain_range_start(worker_index, worker_count, shared);
+        const int end = domain_range_start(worker_index + 1, worker_count, shared);
+        for (int i = begin; i < end; i++) {
+            func(i);
+        }
+        return;
+    }
+    const int* order = shared.orders[shared.current_order];
+    const int* bounds = shared.bounds[shared.current_order];
+    for (int worker = 0; worker < worker_count; worker++) {
+        const int* groups = bounds + worker * (worker_count + 1);
+        for (int slot = groups[worker_index]; slot < groups[worker_index + 1]; slot++) {
+            func(order[slot]);
+        }
+    }
+}
+
+/**
+ * @brief Move the pieces owned by a worker process, the ones in its horizontal strip of the world
+ *
+ * Runs in the worker process. Targets are sampled from all pieces, so the previous positions of the whole world are
+ * read in place from shared memory instead of a halo copied around the strip. Each worker writes the new positions
+ * and state of its own pieces in place, then hands the pieces that left its strip over to their new strip's worker.
+ * @param worker_index - Index of worker and its strip
+ * @param worker_count - Number of workers and strips
+ * @param shared - Shared memory
+ */
+template <typename Scalar>
+static void update_domain_strip(int worker_index, int worker_count, DomainShared& shared)
+{
+    const MoveBuffers& buffers = shared.buffers;
+    const TypeIndexView by_type {
+        std::span<const int>(shared.type_indices[0], shared.type_counts[0]),
+        std::span<const int>(shared.type_indices[1], shared.type_counts[1]),
+        std::span<const int>(shared.type_indices[2], shared.type_counts[2]),
+    };
+    TargetCacheStats stats {};
+    for_each_owned_piece(worker_index, worker_count, shared, [&](int i) {
+        update_piece_pos<Scalar>(buffers, by_type, shared.world, shared.movement, i, shared.random_seed, stats);
+    });
+    shared.target_hits.fetch_add(stats.hits, std::memory_order_relaxed);
+    shared.target_misses.fetch_add(stats.misses, std::memory_order_relaxed);
+
+    // Pieces are counted per strip of their new position, then written grouped by strip to this worker's range of the
+    // next order
+    const float strip_height = static_cast<float>(shared.world.height) / static_cast<float>(worker_count);
+    const auto new_strip = [&](int i) {
+        const raylib::Vector2 pos = moved_position(buffers, shared.world, shared.movement.piece_size, i);
+        return domain_strip(pos, strip_height, worker_count);
+    };
+    const int next_order = 1 - shared.current_order;
+    int* groups = shared.bounds[next_order] + worker_index * (worker_count + 1);
+    std::fill(groups, groups + worker_count + 1, 0);
+    for_each_owned_piece(worker_index, worker_count, shared, [&](int i) { groups[new_strip(i) + 1]++; });
+    groups[0] = domain_range_start(worker_index, worker_count, shared);
+    for (int strip = 0; strip < worker_count; strip++) {
+        groups[strip + 1] += groups[strip];
+    }
+    std::vector<int> slots(groups, groups + worker_count);
+    for_each_owned_piece(
+        worker_index, worker_count, shared, [&](int i) { shared.orders[next_order][slots[new_strip(i)]++] = i; });
+}
+
+/**
+ * @brief Get size of the arena the simulation buffers are allocated from while domain workers run
+ * @param piece_capacity - Maximum number of pieces in shared memory
+ * @return - Returns size in bytes
+ */
+static size_t domain_arena_size(int piece_capacity)
+{
+    // Pieces, the position buffers and the three type index lists, each large enough for all pieces and padded for
+    // alignment
+    return (sizeof(Piece) + c_position_bytes + sizeof(int) * 3) * static_cast<size_t>(piece_capacity)
+        + alignof(std::max_align_t) * 6;
+}
+
+/**
+ * @brief Get size of memory shared with domain worker processes
+ * @param worker_count - Number of workers
+ * @param piece_capacity - Maximum number of pieces in shared memory
+ * @return - Returns size in bytes
+ */
+static size_t domain_shared_size(int worker_count, int piece_capacity)
+{
+    const size_t bounds_size = static_cast<size_t>(worker_count) * (worker_count + 1);
+    return sizeof(DomainShared) + sizeof(int) * (bounds_size + piece_capacity) * 2 + domain_arena_size(piece_capacity);
+}
+
+size_t estimate_memory_bytes(int piece_count, int worker_capacity)
+{
+    const auto count = static_cast<size_t>(piece_count);
+    // Type index lists grow one index at a time, with doubling slack up to twice the count between them. Pieces and
+    // position buffers are sized to the count, in shared memory the arena holds them and every list at full capacity
+    const size_t buffer_bytes = worker_capacity > 0
+        ? domain_arena_size(worker_capacity) + sizeof(int) * 2 * static_cast<size_t>(worker_capacity)
+        : (sizeof(Piece) + c_position_bytes + sizeof(int) * 2) * count;
+    // Type slot, conversion mark, and the spatial index with a cell and an index per piece and a start per cell, whose
+    // cells hold at least about one piece each
+    const size_t piece_bytes = sizeof(int) + sizeof(uint8_t) + sizeof(int) * 3;
+#if defined(RPS_COMPACT)
+    // Spawn buffers hold one block of positions
+    const size_t spawn_bytes = 0;
+#else
+    const size_t spawn_bytes = sizeof(float) * 2;
+#endif
+    return buffer_bytes + (piece_bytes + spawn_bytes) * count;
+}
+
+void check_memory_budget(int piece_count, size_t needed_bytes, size_t budget_bytes)
+{
+    if (budget_bytes != 0 && needed_bytes > budget_bytes) {
+        const size_t megabyte = 1024 * 1024;
+        throw std::runtime_error(
+            "Simulation of " + std::to_string(piece_count) + " pieces needs about "
+            + std::to_string(needed_bytes / megabyte) + " MB, more than the memory budget of "
+            + std::to_string(budget_bytes / megabyte) + " MB");
+    }
+}
+
+/**
+ * @brief Move a buffer to memory allocated from another resource
+ * @param values - Buffer to move, its elements are kept
+ * @param memory - Resource to allocate from
+ * @param capacity - Number of elements to reserve
+ */
+template <typename T>
+static void move_buffer(std::pmr::vector<T>& values, std::pmr::memory_resource* memory, size_t capacity)
+{
+    std::pmr::vector<T> moved(memory);
+    moved.reserve(std::max(capacity, values.size()));
+    moved.assign(values.begin(), values.end());
+    // Assignment keeps the resource of the assigned vector, so the buffer is recreated from the moved one instead
+    std::destroy_at(&values);
+    std::construct_at(&values, std::move(moved));
+}
+
+/**
+ * @brief Move pieces, positions and type indices to memory allocated from another resource
+ * @param sim - Simulation whose buffers are moved
+ * @param memory - Resource to allocate from
+ * @param capacity - Number of pieces to reserve
+ */
+static void move_buffers(Simulation& sim, std::pmr::memory_resource* memory, size_t capacity)
+{
+    move_buffer(sim.pieces, memory, capacity);
+    for_each_position_buffer(sim, [&](auto& positions) { move_buffer(positions, memory, capacity); });
+    for (std::pmr::vector<int>& indices : sim.type_indices) {
+        move_buffer(indices, memory, capacity);
+    }
+}
+
+void start_domain_workers(Simulation& sim, int worker_count, int piece_capacity)
+{
+    // Buffers are moved out of the memory shared with running workers before it is unmapped
+    if (sim.domain_memory != nullptr) {
+        move_buffers(sim, std::pmr::get_default_resource(), 0);
+        sim.domain_memory.reset();
+    }
+
+    sim.domain_workers.start(
+        worker_count,
+        domain_shared_size(worker_count, piece_capacity),
+        [](int worker_index, int worker_count, void* shared) {
+            DomainShared& domain_shared = *static_cast<DomainShared*>(shared);
+            if (domain_shared.is_fixed_point) {
+                update_domain_strip<util::Fixed>(worker_index, worker_count, domain_shared);
+            }
+            else {
+                update_domain_strip<float>(worker_index, worker_count, domain_shared);
+            }
+        });
+    auto* shared = new (sim.domain_workers.shared()) DomainShared {};
+    shared->piece_capacity = piece_capacity;
+    shared->order_count = -1;
+    const size_t bounds_size = static_cast<size_t>(worker_count) * (worker_count + 1);
+    int* tables = reinterpret_cast<int*>(shared + 1);
+    shared->bounds = { tables, tables + bounds_size };
+    shared->orders = { tables + bounds_size * 2, tables + bounds_size * 2 + piece_capacity };
+
+    sim.domain_memory = std::make_unique<std::pmr::monotonic_buffer_resource>(
+        shared->orders[1] + piece_capacity, domain_arena_size(piece_capacity));
+    move_buffers(sim, sim.domain_memory.get(), piece_capacity);
+}
+
+/**
+ * @brief Check if a buffer is in the memory shared with domain workers
+ * @param values - Buffer
+ * @param workers - Running domain workers
+ * @return - Returns false if the buffer grew past its capacity and was reallocated outside of shared memory
+ */
+template <typename T>
+static bool is_domain_shared(const std::pmr::vector<T>& values, const util::ProcessGroup& workers)
+{
+    const auto begin = reinterpret_cast<uintptr_t>(workers.shared());
+    const auto data = reinterpret_cast<uintptr_t>(values.data());
+    return data >= begin && data + values.size() * sizeof(T) <= begin + workers.shared_size();
+}
+
+/**
+ * @brief Restart domain workers with more shared memory if a buffer grew out of it
+ * @param sim - Simulation with running domain workers
+ */
+static void keep_domain_buffers_shared(Simulation& sim)
+{
+    const util::ProcessGroup& workers = sim.domain_workers;
+    bool is_shared = is_domain_shared(sim.pieces, workers);
+    for_each_position_buffer(
+        sim, [&](const auto& positions) { is_shared = is_shared && is_domain_shared(positions, workers); });
+    for (const std::pmr::vector<int>& indices : sim.type_indices) {
+        is_shared = is_shared && is_domain_shared(indices, workers);
+    }
+    if (!is_shared) {
+        // Storage reserved for a larger piece count is kept, so adding pieces does not reallocate the buffers again
+        const int capacity = std::max(
+            static_cast<const DomainShared*>(workers.shared())->piece_capacity,
+            static_cast<int>(sim.pieces.capacity()));
+        start_domain_workers(
+            sim, workers.worker_count(), std::max(static_cast<int>(sim.pieces.size()) * 2, capacity));
+    }
+}
+
+/**
+ * @brief Calculate new pieces positions on the domain worker processes
+ *
+ * The buffers are already in shared memory, so only the parameters of the tick are written before the workers run
+ * and nothing is copied back afterwards.
+ * @param sim - Simulation with running domain workers and buffers in their shared memory
+ * @param buffers - Pieces, their previous positions and the buffer new positions are written to
+ * @param movement - Movement parameters
+ * @param random_seed - Seed of the tick for sampling
+ */
+template <typename Scalar>
+static void update_pieces_pos_domain(
+    Simulation& sim, const MoveBuffers& buffers, const Movement& movement, uint64_t random_seed)
+{
+    DomainShared& shared = *static_cast<DomainShared*>(sim.domain_workers.shared());
+    shared.world = sim.world;
+    shared.movement = movement;
+    shared.piece_count = static_cast<int>(buffers.pieces.size());
+    shared.random_seed = random_seed;
+    shared.is_fixed_point = std::is_same_v<Scalar, util::Fixed>;
+    shared.buffers = buffers;
+    for (int type = 0; type < 3; type++) {
+        shared.type_indices[type] = sim.type_indices[type].data();
+        shared.type_counts[type] = static_cast<int>(sim.type_indices[type].size());
+    }
+    shared.target_hits = 0;
+    shared.target_misses = 0;
+
+    sim.domain_workers.step();
+
+    sim.target_stats.hits += shared.target_hits;
+    sim.target_stats.misses += shared.target_misses;
+    // Workers own the pieces of their strip in the order they wrote during the tick
+    shared.current_order = 1 - shared.current_order;
+    shared.order_count = shared.piece_count;
+}
+
+#if defined(RPS_COMPACT)
+/**
+ * @brief Add the displacements of the last movement to the packed positions, once no piece reads them anymore
+ *
+ * Pieces clamped at a bounded world edge keep the displacement they actually moved, so the previous position stays
+ * exact. Split into chunks over the thread pool if there is one.
+ * @param sim - Simulation to update
+ * @param piece_size - Size of piece
+ */
+static void apply_position_deltas(Simulation& sim, int piece_size)
+{
+    const auto apply_chunk = [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const PackedPosition prev_pos = sim.packed_positions[i];
+            const PackedPosition pos = move_packed_position(sim.world, piece_size, prev_pos, sim.position_deltas[i]);
+            if (sim.world.topology == WorldTopology::e_bounded) {
+                const auto moved = [](int64_t from, int64_t to) {
+                    return static_cast<int16_t>(std::clamp(to - from, int64_t(-32768), int64_t(32767)));
+                };
+                sim.position_deltas[i] = PackedVector {
+                    moved(fixed_x(prev_pos), fixed_x(pos)),
+                    moved(fixed_y(prev_pos), fixed_y(pos)),
+                };
+            }
+            sim.packed_positions[i] = pos;
+        }
+    };
+
+    const int count = static_cast<int>(sim.pieces.size());
+    if (sim.thread_pool != nullptr) {
+        sim.thread_pool->parallel_for(count, 1024, apply_chunk);
+    }
+    else {
+        apply_chunk(0, count);
+    }
+}
+#endif
+
+/**
+ * @brief Convert a piece to another type and count the conversion
+ * @param sim - Simulation the piece is in
+ * @param index - Index of piece
+ * @param type - Type the piece converts to
+ */
+static void convert_piece(Simulation& sim, int index, PieceType type)
+{
+    set_piece_type(sim, index, type);
+    sim.conversions[static_cast<int>(type)]++;
+}
+
+/**
+ * @brief Get the type that converts pieces of a type when they collide
+ * @param type - Type of piece
+ * @return - Returns type that beats it
+ */
+static PieceType beating_type(PieceType type)
+{
+    switch (type) {
+    case PieceType::e_rock:
+        return PieceType::e_paper;
+    case PieceType::e_paper:
+        return PieceType::e_scissors;
+    case PieceType::e_scissors:
+        return PieceType::e_rock;
+    }
+    return type;
+}
+
+/**
+ * @brief Mark the losing piece of two pieces if they collide, to be converted after all pairs are checked
+ * @param sim - Simulation the pieces are in
+ * @param index1 - Index of piece 1
+ * @param index2 - Index of piece 2
+ * @param piece_size - Size of piece
+ */
+template <typename Scalar>
+static void update_piece_types(Simulation& sim, int index1, int index2, int piece_size)
+{
+    const Piece& p1 = sim.pieces[index1];
+    const Piece& p2 = sim.pieces[index2];
+    if (p1.type == p2.type) {
+        return;
+    }
+    const TickVector<Scalar> delta = tick_delta(
+        sim.world, to_tick_vector<Scalar>(position(sim, index1)), to_tick_vector<Scalar>(position(sim, index2)));
+
+    // Quick exit if pieces are far apart
+    const Scalar size(static_cast<float>(piece_size));
+    if (delta.length_sqr() > size * size * Scalar(2.0f)) {
+        return;
+    }
+
+    // Equally sized collision rectangles overlap when they are closer than their size on both axes
+    using std::abs;
+    const Scalar inner_padding = size * Scalar(0.15f);
+    const Scalar collision_size = size - inner_padding;
+    if (abs(delta.x) >= collision_size || abs(delta.y) >= collision_size) {
+        return;
+    }
+
+    // A piece can only lose to one type, so the mark alone tells what it converts to. Rows of regions are checked
+    // concurrently and any of them may mark the same piece, all with the same value
+    const int loser = beating_type(p1.type) == p2.type ? index1 : index2;
+    std::atomic_ref(sim.is_converting[loser]).store(1, std::memory_order_relaxed);
+}
+
+template <typename Scalar>
+void update_collisions(Simulation& sim, int piece_size)
+{
+    RPS_PROFILE_ZONE("Collisions");
+    sim.conversions = {};
+    // Marks are cleared when they are applied, so only new pieces need clearing
+    sim.is_converting.resize(sim.pieces.size(), 0);
+
+    const util::SpatialGrid& grid = sim.grid;
+    const World& world = sim.world;
+    const int cols = grid.cols();
+    const int rows = grid.rows();
+    // With fewer than three regions across, wrapping would visit the same neighbor twice
+    const bool wrap_cols = world.topology == WorldTopology::e_toroidal && cols >= 3;
+    const bool wrap_rows = world.topology == WorldTopology::e_toroidal && rows >= 3;
+    const int neighbor_offsets[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+
+    // Pairs only read positions and types and marks are idempotent, so rows of regions need no coloring schedule
+    const auto check_rows = [&](int begin, int end) {
+        for (int row = begin; row < end; row++) {
+            for (int col = 0; col < cols; col++) {
+                const std::span<const int> cell = grid.cell(row * cols + col);
+                for (size_t i = 0; i < cell.size(); i++) {
+                    for (size_t j = i + 1; j < cell.size(); j++) {
+                        update_piece_types<Scalar>(sim, cell[i], cell[j], piece_size);
+                    }
+                }
+
+                for (const auto& offset : neighbor_offsets) {
+                    int neighbor_col = col + offset[0];
+                    int neighbor_row = row + offset[1];
+                    if (wrap_cols) {
+                        neighbor_col = (neighbor_col + cols) % cols;
+                    }
+                    if (wrap_rows) {
+                        neighbor_row = (neighbor_row + rows) % rows;
+                    }
+                    if (neighbor_col < 0 || neighbor_col >= cols || neighbor_row < 0 || neighbor_row >= rows) {
+                        continue;
+                    }
+                    const std::span<const int> neighbor = grid.cell(neighbor_row * cols + neighbor_col);
+                    for (int i : cell) {
+                        for (int j : neighbor) {
+                            update_piece_types<Scalar>(sim, i, j, piece_size);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // Keep enough regions in a chunk to cover the cost of handing it to another thread
+    const int min_rows = std::max(1, 2048 / std::max(cols, 1));
+    if (sim.thread_pool != nullptr) {
+        sim.thread_pool->parallel_for(rows, min_rows, check_rows);
+    }
+    else {
+        check_rows(0, rows);
+    }
+
+    // Applied in index order so the type index lists, and with them later target samples, do not depend on pair order
+    for (int i = 0; i < sim.pieces.size(); i++) {
+        if (sim.is_converting[i] != 0) {
+            sim.is_converting[i] = 0;
+            convert_piece(sim, i, beating_type(sim.pieces[i].type));
+        }
+    }
+}
+
+void update_grid(Simulation& sim, int piece_size)
+{
+    RPS_PROFILE_ZONE("Grid");
+    // Cells hold about one piece on average but are never smaller than a piece
+    const float area = static_cast<float>(sim.world.width) * static_cast<float>(sim.world.height);
+    const float cell_size = std::max(
+        static_cast<float>(piece_size), std::sqrt(area / static_cast<float>(std::max<size_t>(sim.pieces.size(), 1))));
+    sim.grid.build(
+        static_cast<int>(sim.pieces.size()),
+        cell_size,
+        static_cast<float>(sim.world.width),
+        static_cast<float>(sim.world.height),
+        // Wrapped neighbor regions must be full size, a narrow last column would miss pieces overlapping the seam
+        sim.world.topology == WorldTopology::e_toroidal ? util::GridFit::e_tile : util::GridFit::e_cover,
+        [&](int i) { return position(sim, i); });
+}
+
+template <typename Scalar>
+void move_pieces(Simulation& sim, const Movement& movement)
+{
+    RPS_PROFILE_ZONE("Movement");
+    sim.target_stats = {};
+
+    // Buffers have to be in the memory shared with domain workers before views of them are taken
+    if (sim.domain_workers.is_running()) {
+        keep_domain_buffers_shared(sim);
+    }
+
+#if defined(RPS_COMPACT)
+    const MoveBuffers buffers {
+        .pieces = sim.pieces,
+        .prev_positions = sim.packed_positions,
+        .deltas = sim.position_deltas,
+    };
+#else
+    // Current positions become the previous ones by swapping buffers, the other buffer is overwritten by movement
+    const int next_buffer = 1 - sim.current_buffer;
+    const MoveBuffers buffers {
+        .pieces = sim.pieces,
+        .prev_positions = sim.position_buffers[sim.current_buffer],
+        .positions = sim.position_buffers[next_buffer],
+    };
+#endif
+
+    // Moving pieces is deterministic for any number of threads or processes given the same seed
+    const uint64_t random_seed = static_cast<uint64_t>(sim.random.next()) << 32 | sim.random.next();
+    if (sim.domain_workers.is_running()) {
+        update_pieces_pos_domain<Scalar>(sim, buffers, movement, random_seed);
+    }
+    else {
+        update_pieces_pos<Scalar>(sim, buffers, movement, random_seed);
+    }
+#if defined(RPS_COMPACT)
+    apply_position_deltas(sim, movement.piece_size);
+#else
+    sim.current_buffer = next_buffer;
+#endif
+}
+
+template <typename Scalar>
+void step(Simulation& sim, const Movement& movement)
+{
+    move_pieces<Scalar>(sim, movement);
+    // Regions exchange pieces that crossed their boundaries by rebuilding the grid after movement
+    update_grid(sim, movement.piece_size);
+    update_collisions<Scalar>(sim, movement.piece_size);
+    sim.tick++;
+}
+
+template void move_pieces<float>(Simulation& sim, const Movement& movement);
+template void move_pieces<util::Fixed>(Simulation& sim, const Movement& movement);
+template void update_collisions<float>(Simulation& sim, int piece_size);
+template void update_collisions<util::Fixed>(Simulation& sim, int piece_size);
+template void step<float>(Simulation& sim, const Movement& movement);
+template void step<util::Fixed>(Simulation& sim, const Movement& movement);
+
+uint64_t state_checksum(const Simulation& sim)
+{
+    // FNV-1a over the state that affects later ticks, floats by their bits so any difference in rounding shows
+    uint64_t hash = 0xcbf29ce484222325;
+    const auto mix = [&](uint64_t value) { hash = (hash ^ value) * 0x100000001b3; };
+    mix(sim.tick);
+    for (int i = 0; i < sim.pieces.size(); i++) {
+        const Piece& p = sim.pieces[i];
+        const raylib::Vector2 pos = position(sim, i);
+        const raylib::Vector2 vel = velocity(p);
+        mix(static_cast<uint64_t>(p.type));
+        mix(std::bit_cast<uint32_t>(pos.x));
+        mix(std::bit_cast<uint32_t>(pos.y));
+        mix(std::bit_cast<uint32_t>(vel.x));
+        mix(std::bit_cast<uint32_t>(vel.y));
+        mix(static_cast<uint64_t>(p.target));
+        mix(static_cast<uint64_t>(p.target_ticks));
+    }
+    for (const std::pmr::vector<int>& indices : sim.type_indices) {
+        for (int index : indices) {
+            mix(static_cast<uint64_t>(index));
+        }
+    }
+    return hash;
+}
+
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <raylib-cpp.hpp>
+
+#include "fixed_point.hpp"
+#include "process_group.hpp"
+#include "random.hpp"
+#include "spatial_grid.hpp"
+#include "thread_pool.hpp"
+
+namespace rps {
+
+/**
+ * @brief Scalar type the game does tick math in, util::Fixed when configured with RPS_FIXED_POINT
+ */
+#if defined(RPS_FIXED_POINT)
+using SimulationScalar = util::Fixed;
+#else
+using SimulationScalar = float;
+#endif
+
+/**
+ * @brief Types of pieces
+ */
+enum class PieceType : uint8_t {
+    e_rock,
+    e_paper,
+    e_scissors,
+};
+
+/**
+ * @brief How pieces are placed when the simulation is reset
+ */
+enum class SpawnPlacement {
+    // Independent uniform positions
+    e_uniform,
+    // One piece per cell of a jittered grid covering the screen
+    e_stratified,
+};
+
+/**
+ * @brief How pieces behave at the edges of the world
+ */
+enum class WorldTopology {
+    // Pieces are clamped inside the world
+    e_bounded,
+    // Pieces leaving one edge enter from the opposite edge
+    e_toroidal,
+};
+
+/**
+ * @brief How pieces move towards or away from their targets
+ */
+enum class MovementModel {
+    // Pieces move at a constant speed directly to or from their target. Both models cache the target and sample a new
+    // one once target_ticks runs out, either piece converted away from target_type, or the distance left the band
+    // around target_dist
+    e_direct,
+    // Pieces keep a velocity and accelerate towards their desired velocity to or from the cached target
+    e_steering,
+};
+
+#if defined(RPS_COMPACT)
+/**
+ * @brief Vector in 16-bit fixed point with 8 fractional bits, so steps of 1/256 of a pixel up to 128 pixels
+ */
+struct PackedVector {
+    int16_t x;
+    int16_t y;
+};
+
+/**
+ * @brief Position in 16-bit fixed point relative to the origin of the chunk of the world it is in
+ *
+ * Chunks are c_chunk_size pixels square, offsets are in steps of 1/256 of a pixel.
+ */
+struct PackedPosition {
+    uint16_t x;
+    uint16_t y;
+    uint16_t chunk_x;
+    uint16_t chunk_y;
+};
+
+/**
+ * @brief Width and height of a chunk of the world in pixels, the 16-bit offsets of packed positions span one chunk
+ */
+inline constexpr int c_chunk_size = 256;
+
+/**
+ * @brief Largest width or height of a world in a compact build, chunk coordinates are 16-bit
+ */
+inline constexpr int c_max_compact_world_size = c_chunk_size * 0xffff;
+
+/**
+ * @brief Largest number of ticks a cached target is kept, the counter is 12 bits in a compact build
+ */
+inline constexpr int c_max_target_ticks = 0xfff;
+
+/**
+ * @brief Piece state other than its position, positions are kept in the simulation packed positions
+ *
+ * Compact build: velocity is 16-bit fixed point and both types take 2 bits next to the target tick counter.
+ */
+struct Piece {
+    // Velocity, only used by the steering movement model
+    PackedVector vel;
+    // Cached target piece index (-1 if none)
+    int target;
+    // Squared distance to the target when it was found, used to invalidate the cached target
+    float target_dist;
+    // Number of ticks the cached target is kept before searching again
+    uint16_t target_ticks : 12;
+    PieceType type : 2;
+    // Type of the target when it was found, used to invalidate the cached target
+    PieceType target_type : 2;
+};
+#else
+/**
+ * @brief Largest number of ticks a cached target is kept
+ */
+inline constexpr int c_max_target_ticks = 0xffff;
+
+/**
+ * @brief Piece state other than its position, positions are kept in the simulation position buffers
+ *
+ * Fields are ordered by size so the struct has no padding, it is the largest per-piece cost at high piece counts.
+ */
+struct Piece {
+    // Velocity, only used by the steering movement model
+    raylib::Vector2 vel;
+    // Cached target piece index (-1 if none)
+    int target;
+    // Squared distance to the target when it was found, used to invalidate the cached target
+    float target_dist;
+    // Number of ticks the cached target is kept before searching again
+    uint16_t target_ticks;
+    PieceType type;
+    // Type of the target when it was found, used to invalidate the cached target
+    PieceType target_type;
+};
+#endif
+
+/**
+ * @brief Number of cached targets reused and searched again
+ */
+struct TargetCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/**
+ * @brief Parameters of piece movement shared by all pieces
+ */
+struct Movement {
+    MovementModel model;
+    int piece_size;
+    int samples;
+    float max_acceleration;
+    float damping;
+    int target_refresh_ticks;
+    float target_distance_band;
+};
+
+/**
+ * @brief Simulated area, independent of the window
+ */
+struct World {
+    int width;
+    int height;
+    WorldTopology topology;
+};
+
+/**
+ * @brief Random source and reusable position buffers for spawning pieces
+ */
+struct Spawner {
+    util::Random random;
+    SpawnPlacement placement;
+    std::vector<float> x;
+    std::vector<float> y;
+};
+
+/**
+ * @brief Read-only view of piece indices grouped by piece type
+ */
+using TypeIndexView = std::array<std::span<const int>, 3>;
+
+/**
+ * @brief Simulation state, independent of any window, audio or input
+ */
+struct Simulation {
+    // Worker processes that move pieces when the world is split over several processes
+    util::ProcessGroup domain_workers;
+    // Allocates pieces, positions and type indices from the memory shared with domain workers, so workers read and
+    // write them in place. Declared before the buffers it allocates so it outlives them
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> domain_memory;
+
+    World world;
+    std::pmr::vector<Piece> pieces;
+#if defined(RPS_COMPACT)
+    // Positions of pieces at the current tick, indexed like pieces
+    std::pmr::vector<PackedPosition> packed_positions;
+    // Displacement of each piece during the last tick, the previous position is the current one minus it. Movement
+    // only writes these while other pieces read the positions, then they are added to the positions
+    std::pmr::vector<PackedVector> position_deltas;
+#else
+    // Positions of pieces at the previous and current tick, indexed like pieces. Movement reads the current buffer and
+    // writes the other one, then the buffers are swapped by index instead of copied
+    std::array<std::pmr::vector<raylib::Vector2>, 2> position_buffers;
+    int current_buffer;
+#endif
+    // Dense indices of pieces of each type, in no particular order, kept in sync with piece types
+    std::array<std::pmr::vector<int>, 3> type_indices;
+    // Position of each piece in the index list of its type
+    std::vector<int> type_slots;
+    // Spatial index over current piece positions
+    util::SpatialGrid grid;
+    Spawner spawner;
+    // Random source for target sampling
+    util::Random random;
+
+    // Number of ticks run so far
+    uint64_t tick;
+    // Target cache statistics of the last tick
+    TargetCacheStats target_stats;
+    // Number of pieces converted to each type during the last tick
+    std::array<int, 3> conversions;
+    // Pieces that lost a collision in the current tick, converted once all pairs are checked
+    std::vector<uint8_t> is_converting;
+
+    // Threads collisions are checked on, and pieces are moved on without domain workers. Null uses the calling thread
+    util::ThreadPool* thread_pool;
+};
+
+/**
+ * @brief Get shortest displacement between two positions, across the edges for a toroidal world
+ * @param world - World the positions are in
+ * @param from - Start position
+ * @param to - End position
+ * @return - Returns displacement from start to end
+ */
+raylib::Vector2 world_delta(const World& world, raylib::Vector2 from, raylib::Vector2 to);
+
+/**
+ * @brief Keep a piece position inside the world by clamping or wrapping it depending on topology
+ * @param world - World the position is in
+ * @param pos - Piece position
+ * @param piece_size - Size of piece
+ * @return - Returns position inside the world
+ */
+raylib::Vector2 world_constrain(const World& world, raylib::Vector2 pos, int piece_size);
+
+/**
+ * @brief Get position of a piece at the current tick
+ * @param sim - Simulation the piece is in
+ * @param index - Index of piece
+ * @return - Returns position
+ */
+raylib::Vector2 position(const Simulation& sim, int index);
+
+/**
+ * @brief Move a piece to a position at the current and the previous tick, so it is not drawn moving there
+ * @param sim - Simulation the piece is in
+ * @param index - Index of piece
+ * @param pos - New position
+ */
+void set_position(Simulation& sim, int index, raylib::Vector2 pos);
+
+/**
+ * @brief Get piece position interpolated between ticks, without crossing the world when it wrapped around
+ * @param sim - Simulation the piece is in
+ * @param index - Index of piece
+ * @param blend - Blend fraction for position interpolation
+ * @return - Returns interpolated position
+ */
+raylib::Vector2 interpolate_pos(const Simulation& sim, int index, float blend);
+
+/**
+ * @brief Reset pieces list in place to a new random population, reusing its existing storage
+ * @param sim - Simulation to reset
+ * @param count - Number of pieces
+ * @throws std::runtime_error if the world is larger than packed positions reach in a compact build
+ */
+void reset_pieces(Simulation& sim, int count);
+
+/**
+ * @brief Move pieces list in place towards a new count
+ *
+ * Removal truncates immediately. Additions are spread over several calls so that large count changes do not stall a
+ * single frame. Storage for the new count is reserved by the first call, so the calls adding the rest do not
+ * reallocate.
+ * @param sim - Simulation to update
+ * @param new_count - New number of pieces
+ * @param max_added - Maximum number of pieces added by this call
+ */
+void update_piece_count(Simulation& sim, int new_count, int max_added);
+
+/**
+ * @brief Change the type of a piece, moving it between type index lists in constant time
+ * @param sim - Simulation the piece is in
+ * @param index - Index of piece
+ * @param type - New type of piece
+ */
+void set_piece_type(Simulation& sim, int index, PieceType type);
+
+/**
+ * @brief Get type that all pieces have, checking only the sizes of the type index lists
+ * @param sim - Simulation to check
+ * @return - Returns winning type or null if more than one type is left or there are no pieces
+ */
+std::optional<PieceType> winner(const Simulation& sim);
+
+/**
+ * @brief Rebuild spatial index over current piece positions
+ * @param sim - Simulation to update
+ * @param piece_size - Size of piece
+ */
+void update_grid(Simulation& sim, int piece_size);
+
+/**
+ * @brief Estimate memory a simulation of a number of pieces needs, including its spatial index and spawn buffers
+ *
+ * Buffers that grow one piece at a time are counted with the slack of growing by doubling.
+ * @param piece_count - Number of pieces
+ * @param worker_capacity - Piece capacity of the domain worker shared memory, 0 without domain workers
+ * @return - Returns estimated size in bytes
+ */
+size_t estimate_memory_bytes(int piece_count, int worker_capacity);
+
+/**
+ * @brief Check that a simulation fits in a memory budget before any of it is allocated
+ * @param piece_count - Number of pieces
+ * @param needed_bytes - Estimated size, see estimate_memory_bytes
+ * @param budget_bytes - Memory budget, 0 for no limit
+ * @throws std::runtime_error if the estimated size is larger than the budget
+ */
+void check_memory_budget(int piece_count, size_t needed_bytes, size_t budget_bytes);
+
+/**
+ * @brief Fork domain worker processes with shared memory for a number of pieces
+ *
+ * Pieces, positions and type indices are moved into the shared memory, where the workers move the pieces in place.
+ * Buffers that later grow past the capacity restart the workers with more memory on the next tick.
+ * @param sim - Simulation whose workers are (re)started
+ * @param worker_count - Number of worker processes
+ * @param piece_capacity - Maximum number of pieces in shared memory
+ * @throws std::runtime_error if the workers cannot be started
+ */
+void start_domain_workers(Simulation& sim, int worker_count, int piece_capacity);
+
+/**
+ * @brief Move every piece towards or away from its target, the first kernel of a tick
+ * @tparam Scalar - Type distances, velocities and new positions are computed in, float or util::Fixed
+ * @param sim - Simulation to update
+ * @param movement - Movement parameters
+ * @throws std::runtime_error if a domain worker exited
+ */
+template <typename Scalar = SimulationScalar>
+void move_pieces(Simulation& sim, const Movement& movement);
+
+/**
+ * @brief Update piece types for all colliding pieces, region by region, the last kernel of a tick
+ *
+ * Each grid cell is a region that owns the pieces inside it. Pieces are checked against the others in their region
+ * and against the boundary pieces of the forward neighbor regions, so every nearby pair is visited exactly once.
+ * The grid cells must be at least as large as a piece.
+ *
+ * Conversions are decided from the types at the start of the pass and applied after it in piece index order, so the
+ * result does not depend on the order pairs are visited in. A piece touching the type that beats it converts even if
+ * it converts another piece in the same tick. Rows of regions are checked on the thread pool if there is one, only
+ * the conversions are applied on the calling thread.
+ * @tparam Scalar - Type overlap tests are computed in, float or util::Fixed
+ * @param sim - Simulation with a spatial index over current piece positions
+ * @param piece_size - Size of piece
+ */
+template <typename Scalar = SimulationScalar>
+void update_collisions(Simulation& sim, int piece_size);
+
+/**
+ * @brief Get checksum of the simulation state that affects later ticks
+ *
+ * Ticks are deterministic, the checksum after a tick is the same for any number of threads or domain workers.
+ * @param sim - Simulation to check
+ * @return - Returns 64-bit checksum
+ */
+uint64_t state_checksum(const Simulation& sim);
+
+/**
+ * @brief Run one tick: move pieces, rebuild the spatial index and convert colliding pieces
+ *
+ * Same as calling move_pieces, update_grid and update_collisions in order, then advancing the tick count. Positions
+ * and velocities are stored as floats, or 16-bit fixed point in a compact build, either way. With util::Fixed math
+ * only converts to and from them, so a tick gives bit-identical results on every platform.
+ * @tparam Scalar - Type tick math is computed in, float or util::Fixed
+ * @param sim - Simulation to advance
+ * @param movement - Movement parameters
+ * @throws std::runtime_error if a domain worker exited
+ */
+template <typename Scalar = SimulationScalar>
+void step(Simulation& sim, const Movement& movement);
+
+}
@@ -0,0 +1,73 @@
+#include "spatial_grid.hpp"
+
+#include <cmath>
+
+namespace util {
+
+SpatialGrid::SpatialGrid()
+{
+    m_cell_width = 1.0f;
+    m_cell_height = 1.0f;
+    m_cols = 0;
+    m_rows = 0;
+}
+
+int SpatialGrid::cols() const
+{
+    return m_cols;
+}
+
+int SpatialGrid::rows() const
+{
+    return m_rows;
+}
+
+int SpatialGrid::count() const
+{
+    return static_cast<int>(m_indices.size());
+}
+
+void SpatialGrid::resize(int count, float cell_size, float width, float height, GridFit fit)
+{
+    cell_size = std::max(cell_size, 1.0f);
+    switch (fit) {
+    case GridFit::e_cover:
+        m_cols = std::max(1, static_cast<int>(std::ceil(width / cell_size)));
+        m_rows = std::max(1, static_cast<int>(std::ceil(height / cell_size)));
+        m_cell_width = cell_size;
+        m_cell_height = cell_size;
+        break;
+    case GridFit::e_tile:
+        m_cols = std::max(1, static_cast<int>(std::floor(width / cell_size)));
+        m_rows = std::max(1, static_cast<int>(std::floor(height / cell_size)));
+        m_cell_width = std::max(width / static_cast<float>(m_cols), 1.0f);
+        m_cell_height = std::max(height / static_cast<float>(m_rows), 1.0f);
+        break;
+    }
+    m_cell_start.resize(static_cast<size_t>(m_cols) * m_rows + 1);
+    m_indices.resize(count);
+    m_point_cells.resize(count);
+}
+
+void SpatialGrid::sort()
+{
+    // Count points per cell, shifted by one so the prefix sum leaves each cell's start in place
+    std::fill(m_cell_start.begin(), m_cell_start.end(), 0);
+    for (int cell : m_point_cells) {
+        m_cell_start[cell + 1]++;
+    }
+    for (size_t i = 1; i < m_cell_start.size(); i++) {
+        m_cell_start[i] += m_cell_start[i - 1];
+    }
+
+    // Scatter using the start offsets as cursors, then shift them back
+    for (int i = 0; i < static_cast<int>(m_point_cells.size()); i++) {
+        m_indices[m_cell_start[m_point_cells[i]]++] = i;
+    }
+    for (size_t i = m_cell_start.size() - 1; i > 0; i--) {
+        m_cell_start[i] = m_cell_start[i - 1];
+    }
+    m_cell_start[0] = 0;
+}
+
+}
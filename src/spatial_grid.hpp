@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+namespace util {
+
+/**
+ * @brief How a SpatialGrid divides its area into cells
+ */
+enum class GridFit {
+    // Square cells of the requested size, the last column and row may extend past the area
+    e_cover,
+    // Cells stretched so a whole number of them tiles the area exactly, each at least the requested size
+    e_tile,
+};
+
+/**
+ * @brief Uniform grid over a rectangular area that buckets point indices by cell using a counting sort
+ */
+class SpatialGrid {
+
+public:
+    SpatialGrid();
+
+    /**
+     * @brief Rebuild grid from point positions, reusing existing storage
+     * @tparam PosFunc - Callable taking a point index and returning its position (with x and y members)
+     * @param count - Number of points
+     * @param cell_size - Width and height of each cell, the minimum when tiling
+     * @param width - Width of area covered by the grid
+     * @param height - Height of area covered by the grid
+     * @param fit - How cells are fitted to the area
+     * @param pos_of - Position callback
+     */
+    template <typename PosFunc>
+    void build(int count, float cell_size, float width, float height, GridFit fit, PosFunc&& pos_of)
+    {
+        resize(count, cell_size, width, height, fit);
+        for (int i = 0; i < count; i++) {
+            const auto pos = pos_of(i);
+            m_point_cells[i] = cell_at(pos.x, pos.y);
+        }
+        sort();
+    }
+
+    /**
+     * @brief Get cell containing a position, positions outside the area map to the nearest edge cell
+     * @param x
+     * @param y
+     * @return - Returns cell index
+     */
+    [[nodiscard]] int cell_at(float x, float y) const
+    {
+        const int col = std::clamp(static_cast<int>(x / m_cell_width), 0, m_cols - 1);
+        const int row = std::clamp(static_cast<int>(y / m_cell_height), 0, m_rows - 1);
+        return row * m_cols + col;
+    }
+
+    /**
+     * @brief Call function for every point in cells overlapping a rectangle
+     * @tparam Func - Callable taking a point index
+     * @param x - Left of rectangle
+     * @param y - Top of rectangle
+     * @param width - Width of rectangle
+     * @param height - Height of rectangle
+     * @param func - Point callback
+     */
+    template <typename Func>
+    void for_each_in_rect(float x, float y, float width, float height, Func&& func) const
+    {
+        if (m_cols == 0) {
+            return;
+        }
+        const int col_begin = std::clamp(static_cast<int>(x / m_cell_width), 0, m_cols - 1);
+        const int col_end = std::clamp(static_cast<int>((x + width) / m_cell_width), 0, m_cols - 1);
+        const int row_begin = std::clamp(static_cast<int>(y / m_cell_height), 0, m_rows - 1);
+        const int row_end = std::clamp(static_cast<int>((y + height) / m_cell_height), 0, m_rows - 1);
+        for (int row = row_begin; row <= row_end; row++) {
+            // Cells in a row are stored contiguously so the whole span is one range
+            const int begin = m_cell_start[row * m_cols + col_begin];
+            const int end = m_cell_start[row * m_cols + col_end + 1];
+            for (int i = begin; i < end; i++) {
+                func(m_indices[i]);
+            }
+        }
+    }
+
+    /**
+     * @brief Get points in a cell
+     * @param index - Cell index (row * cols + col)
+     * @return - Returns indices of points in cell
+     */
+    [[nodiscard]] std::span<const int> cell(int index) const
+    {
+        return { m_indices.data() + m_cell_start[index], m_indices.data() + m_cell_start[index + 1] };
+    }
+
+    /**
+     * @brief Get number of cell columns
+     * @return - Returns column count
+     */
+    [[nodiscard]] int cols() const;
+
+    /**
+     * @brief Get number of cell rows
+     * @return - Returns row count
+     */
+    [[nodiscard]] int rows() const;
+
+    /**
+     * @brief Get number of points the grid was built from
+     * @return - Returns point count
+     */
+    [[nodiscard]] int count() const;
+
+private:
+    float m_cell_width;
+    float m_cell_height;
+    int m_cols;
+    int m_rows;
+    // Start of each cell's range in m_indices, with one extra entry for the end
+    std::vector<int> m_cell_start;
+    std::vector<int> m_indices;
+    std::vector<int> m_point_cells;
+
+    void resize(int count, float cell_size, float width, float height, GridFit fit);
+
+    void sort();
+};
+
+}
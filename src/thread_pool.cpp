@@ -0,0 +1,123 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+#include "profiler.hpp"
+
+namespace util {
+
+static int default_thread_count()
+{
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    return 1;
+#else
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+#endif
+}
+
+ThreadPool::ThreadPool()
+    : ThreadPool(default_thread_count())
+{
+}
+
+ThreadPool::ThreadPool(int thread_count)
+{
+    m_generation = 0;
+    m_busy_workers = 0;
+    m_stopping = false;
+    m_task = nullptr;
+    m_context = nullptr;
+    m_count = 0;
+    m_chunk_size = 1;
+    m_next_chunk = 0;
+
+    for (int i = 1; i < thread_count; i++) {
+        m_workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_work_cv.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::thread_count() const
+{
+    return static_cast<int>(m_workers.size()) + 1;
+}
+
+void ThreadPool::run(int count, int min_chunk, TaskFunc task, void* context)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    // Small ranges are not worth waking workers for
+    if (m_workers.empty() || count <= min_chunk) {
+        task(context, 0, count);
+        return;
+    }
+
+    // Several chunks per thread so uneven chunks balance out
+    const int chunk_size = std::max(min_chunk, count / (thread_count() * 4));
+    {
+        std::lock_guard lock(m_mutex);
+        m_task = task;
+        m_context = context;
+        m_count = count;
+        m_chunk_size = std::max(1, chunk_size);
+        m_next_chunk = 0;
+        m_busy_workers = static_cast<int>(m_workers.size());
+        m_generation++;
+    }
+    m_work_cv.notify_all();
+
+    run_chunks();
+
+    std::unique_lock lock(m_mutex);
+    m_done_cv.wait(lock, [&]() { return m_busy_workers == 0; });
+}
+
+void ThreadPool::run_chunks()
+{
+    while (true) {
+        int begin = m_next_chunk.fetch_add(m_chunk_size, std::memory_order_relaxed);
+        if (begin >= m_count) {
+            return;
+        }
+        RPS_PROFILE_ZONE("Pool chunk");
+        m_task(m_context, begin, std::min(begin + m_chunk_size, m_count));
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_work_cv.wait(lock, [&]() { return m_stopping || m_generation != seen_generation; });
+            if (m_stopping) {
+                return;
+            }
+            seen_generation = m_generation;
+        }
+
+        run_chunks();
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_busy_workers--;
+        }
+        m_done_cv.notify_one();
+    }
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+
+/**
+ * @brief Fixed set of worker threads that split index ranges between them and the calling thread
+ */
+class ThreadPool {
+
+public:
+    /**
+     * @brief Constructs ThreadPool with one thread per hardware thread (including the caller)
+     */
+    ThreadPool();
+
+    /**
+     * @brief Construct ThreadPool
+     * @param thread_count - Total number of threads including the caller, 1 runs everything inline
+     */
+    explicit ThreadPool(int thread_count);
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    /**
+     * @brief Get number of threads work is split over, including the caller
+     * @return - Returns thread count
+     */
+    [[nodiscard]] int thread_count() const;
+
+    /**
+     * @brief Run callback over index range split into chunks, blocks until all chunks are done
+     * @tparam Func - Callable taking (int begin, int end), taken by reference so no copy or allocation is made
+     * @param count - Number of indices
+     * @param min_chunk - Minimum number of indices per chunk
+     * @param func - Chunk callback
+     */
+    template <typename Func>
+    void parallel_for(int count, int min_chunk, Func&& func)
+    {
+        run(
+            count,
+            min_chunk,
+            [](void* context, int begin, int end) {
+                (*static_cast<std::remove_reference_t<Func>*>(context))(begin, end);
+            },
+            const_cast<void*>(static_cast<const void*>(&func)));
+    }
+
+private:
+    using TaskFunc = void (*)(void*, int, int);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    uint64_t m_generation;
+    int m_busy_workers;
+    bool m_stopping;
+
+    TaskFunc m_task;
+    void* m_context;
+    int m_count;
+    int m_chunk_size;
+    std::atomic<int> m_next_chunk;
+
+    void run(int count, int min_chunk, TaskFunc task, void* context);
+
+    void run_chunks();
+
+    void worker_loop();
+};
+
+}